@@ -0,0 +1,132 @@
+#ifndef BACKGROUNDWRITER_HPP
+#define BACKGROUNDWRITER_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+Bounded queue of reusable items consumed by one writer thread. The producer takes a free item, fills it and queues it,
+the writer thread hands queued items to the write function in order and returns them to the free list, so their
+buffers are allocated once. At most capacity items exist, taking one more blocks the producer until one is written.
+*/
+template<typename Item>
+class BackgroundWriter
+{
+private:
+	const std::uint32_t capacity;
+	std::function<bool(const Item&)> write;
+
+	std::mutex mutex;
+	std::condition_variable itemQueued;
+	std::condition_variable itemWritten;
+	std::deque<std::unique_ptr<Item>> queuedItems;
+	std::vector<std::unique_ptr<Item>> freeItems;
+	std::uint32_t allocatedItemsCount = 0;
+	bool stopRequested = false;
+	bool writeFailed = false;
+	std::thread writerThread;
+
+	void writerLoop() noexcept
+	{
+		while (true)
+		{
+			std::unique_ptr<Item> item;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				itemQueued.wait(lock, [this] { return stopRequested || !queuedItems.empty(); });
+				if (queuedItems.empty())
+				{
+					return;
+				}
+				item = std::move(queuedItems.front());
+				queuedItems.pop_front();
+			}
+
+			const bool written = write(*item);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				writeFailed = writeFailed || !written;
+				freeItems.push_back(std::move(item));
+			}
+			itemWritten.notify_one();
+		}
+	}
+
+public:
+	explicit BackgroundWriter(const std::uint32_t capacity_) noexcept : capacity(capacity_)
+	{
+	}
+
+	~BackgroundWriter()
+	{
+		stop();
+	}
+
+	BackgroundWriter(const BackgroundWriter&) = delete;
+	BackgroundWriter& operator=(const BackgroundWriter&) = delete;
+
+	/*
+	Starts the writer thread, write returns false when an item couldn't be written.
+	*/
+	void start(std::function<bool(const Item&)> write_)
+	{
+		write = std::move(write_);
+		stopRequested = false;
+		writerThread = std::thread(&BackgroundWriter::writerLoop, this);
+	}
+
+	bool isRunning() const noexcept
+	{
+		return writerThread.joinable();
+	}
+
+	std::unique_ptr<Item> takeFreeItem()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (freeItems.empty() && allocatedItemsCount < capacity)
+		{
+			++allocatedItemsCount;
+			return std::make_unique<Item>();
+		}
+
+		itemWritten.wait(lock, [this] { return !freeItems.empty(); });
+		std::unique_ptr<Item> item = std::move(freeItems.back());
+		freeItems.pop_back();
+		return item;
+	}
+
+	void queueItem(std::unique_ptr<Item> item)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			queuedItems.push_back(std::move(item));
+		}
+		itemQueued.notify_one();
+	}
+
+	/*
+	Writes the items still queued and joins the writer thread. Returns false when any write failed.
+	*/
+	bool stop()
+	{
+		if (writerThread.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopRequested = true;
+			}
+			itemQueued.notify_one();
+			writerThread.join();
+		}
+		return !writeFailed;
+	}
+};
+
+#endif
\ No newline at end of file
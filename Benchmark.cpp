@@ -0,0 +1,432 @@
+#include "Physics.hpp"
+#include "NarrowPhase.hpp"
+#include "ParticleArrays.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+Sweeps doIteration over particle count, density, radius, substeps count, storage layout, Z-order reorder interval
+and narrow phase kernel.
+Every configuration starts from a jittered lattice generated from a fixed seed, so results are
+comparable across commits. For each one the median and 99th percentile of the step time,
+ns per particle, collisions per second and median phase times are reported as CSV or JSON, together with
+the layout bound kernels alone (integratePositions and the velocity components copy done for histograms)
+and the mean index gap of the cell traversal before and after the last reorder.
+Results go to stdout unless --output is given, progress and errors go to stderr so that stdout can be piped.
+Options (lists are comma separated):
+--particles, --density, --radius, --substeps, --layout (aos, soa), --reorder (0 disables),
+--kernel (scalar, sse42, avx2, the best one the CPU supports by default), --steps, --warmup, --threads,
+--seed, --format (csv, json), --output (file, stdout by default).
+*/
+
+namespace
+{
+	constexpr std::uint32_t BULK_REPETITIONS_COUNT = 100;
+
+	/*
+	Option values of NarrowPhaseKernel in enum order.
+	*/
+	constexpr std::array<std::string_view, 3> KERNEL_OPTION_NAMES = { "scalar", "sse42", "avx2" };
+
+	struct SuiteOptions
+	{
+		std::vector<std::uint32_t> particlesCounts = { 10000, 100000, 1000000, 10000000 };
+		std::vector<float> densities = { 15.f, 30.f, 45.f };
+		std::vector<float> radii = { DEFAULT_CIRCLE_RADIUS };
+		std::vector<std::uint32_t> subStepsCounts = { 5 };
+		std::vector<std::string> layouts = { "aos", "soa" };
+		std::vector<std::uint32_t> reorderIntervals = { 0, 10 };
+		std::vector<std::string> kernels = { std::string(KERNEL_OPTION_NAMES[static_cast<std::size_t>(detectNarrowPhaseKernel())]) };
+		std::uint32_t stepsCount = 20;
+		std::uint32_t warmupStepsCount = 3;
+		std::uint32_t threadsCount = 1;
+		std::uint32_t seed = 1;
+		bool json = false;
+		std::string outputPath;
+	};
+
+	struct BenchmarkCase
+	{
+		std::string layout;
+		std::uint32_t particlesCount;
+		float density;
+		float radius;
+		std::uint32_t subStepsCount;
+		std::uint32_t reorderInterval;
+		std::string kernel;
+	};
+
+	struct BenchmarkResult
+	{
+		BenchmarkCase benchmarkCase;
+		std::uint32_t xMax;
+		std::uint32_t yMax;
+		double medianMs;
+		double p99Ms;
+		double nsPerParticle;
+		double collisionsPerSecond;
+		std::array<double, PHYSICS_PHASES_COUNT> phaseMs;
+		double integrateUs;
+		double copyUs;
+		float indexGapBeforeReorder;
+		float indexGapAfterReorder;
+	};
+
+	template<typename T>
+	bool parseList(const std::string_view text, std::vector<T>& values)
+	{
+		values.clear();
+		std::size_t begin = 0;
+		while (begin <= text.size())
+		{
+			const std::size_t end = std::min(text.find(',', begin), text.size());
+			const std::string_view item = text.substr(begin, end - begin);
+			if constexpr (std::is_same_v<T, std::string>)
+			{
+				values.emplace_back(item);
+			}
+			else
+			{
+				T value{};
+				const auto [last, error] = std::from_chars(item.data(), item.data() + item.size(), value);
+				if (error != std::errc() || last != item.data() + item.size())
+				{
+					return false;
+				}
+				values.push_back(value);
+			}
+			begin = end + 1;
+		}
+		return !values.empty();
+	}
+
+	template<typename T>
+	bool parseSingle(const std::string_view text, T& value)
+	{
+		std::vector<T> values;
+		if (!parseList(text, values) || values.size() != 1)
+		{
+			return false;
+		}
+		value = values.front();
+		return true;
+	}
+
+	/*
+	Kernels are ordered by the instruction sets they need, so a kernel runs when it is not above the detected one.
+	Unknown names are never supported.
+	*/
+	bool isKernelSupported(const std::string_view name) noexcept
+	{
+		const auto it = std::find(KERNEL_OPTION_NAMES.begin(), KERNEL_OPTION_NAMES.end(), name);
+		return it != KERNEL_OPTION_NAMES.end() && static_cast<std::size_t>(it - KERNEL_OPTION_NAMES.begin()) <= static_cast<std::size_t>(detectNarrowPhaseKernel());
+	}
+
+	NarrowPhaseKernel getKernel(const std::string_view name) noexcept
+	{
+		return static_cast<NarrowPhaseKernel>(std::find(KERNEL_OPTION_NAMES.begin(), KERNEL_OPTION_NAMES.end(), name) - KERNEL_OPTION_NAMES.begin());
+	}
+
+	bool parseOptions(const int argc, const char* const* argv, SuiteOptions& options)
+	{
+		for (int i = 1; i < argc; i += 2)
+		{
+			const std::string_view key = argv[i];
+			if (i + 1 == argc)
+			{
+				std::cerr << "Missing value of " << key << "\n";
+				return false;
+			}
+
+			const std::string_view value = argv[i + 1];
+			bool parsed = false;
+			if (key == "--particles")
+			{
+				parsed = parseList(value, options.particlesCounts);
+			}
+			else if (key == "--density")
+			{
+				parsed = parseList(value, options.densities);
+			}
+			else if (key == "--radius")
+			{
+				parsed = parseList(value, options.radii);
+			}
+			else if (key == "--substeps")
+			{
+				parsed = parseList(value, options.subStepsCounts);
+			}
+			else if (key == "--layout")
+			{
+				parsed = parseList(value, options.layouts) && std::all_of(options.layouts.begin(), options.layouts.end(),
+					[](const std::string& layout) {return layout == "aos" || layout == "soa";});
+			}
+			else if (key == "--reorder")
+			{
+				parsed = parseList(value, options.reorderIntervals);
+			}
+			else if (key == "--kernel")
+			{
+				parsed = parseList(value, options.kernels) && std::all_of(options.kernels.begin(), options.kernels.end(),
+					[](const std::string& kernel) {return isKernelSupported(kernel);});
+			}
+			else if (key == "--steps")
+			{
+				parsed = parseSingle(value, options.stepsCount) && options.stepsCount > 0;
+			}
+			else if (key == "--warmup")
+			{
+				parsed = parseSingle(value, options.warmupStepsCount);
+			}
+			else if (key == "--threads")
+			{
+				parsed = parseSingle(value, options.threadsCount);
+			}
+			else if (key == "--seed")
+			{
+				parsed = parseSingle(value, options.seed);
+			}
+			else if (key == "--format")
+			{
+				parsed = value == "csv" || value == "json";
+				options.json = value == "json";
+			}
+			else if (key == "--output")
+			{
+				options.outputPath = value;
+				parsed = true;
+			}
+			else
+			{
+				std::cerr << "Unknown option: " << key << "\n";
+				return false;
+			}
+
+			if (!parsed)
+			{
+				std::cerr << "Invalid value of " << key << ": " << value << "\n";
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/*
+	Lattice with spacing chosen so that the requested density is met, jitter never makes neighbours overlap.
+	Domain keeps 16:9 aspect ratio.
+	*/
+	template<typename PosArrType, typename VelArrType>
+	void generateLatticeStart(PosArrType& positions, VelArrType& velocities, const BenchmarkCase& benchmarkCase, const std::uint32_t seed,
+		std::uint32_t& xMax, std::uint32_t& yMax)
+	{
+		const float spacing = 2.f * benchmarkCase.radius * sqrtf(100.f / benchmarkCase.density);
+		const std::uint32_t columns = static_cast<std::uint32_t>(ceilf(sqrtf(benchmarkCase.particlesCount * 16.f / 9.f)));
+		const std::uint32_t rows = (benchmarkCase.particlesCount + columns - 1) / columns;
+		xMax = static_cast<std::uint32_t>(ceilf(columns * spacing));
+		yMax = static_cast<std::uint32_t>(ceilf(rows * spacing));
+
+		std::mt19937 engine(seed);
+		const float jitter = std::max(0.f, 0.5f * spacing - benchmarkCase.radius);
+		std::uniform_real_distribution<float> jitterDistr(-jitter, jitter);
+		std::uniform_real_distribution<float> vxDistr(vxMin, vxMax);
+		std::uniform_real_distribution<float> vyDistr(vyMin, vyMax);
+		for (std::uint32_t i = 0; i < benchmarkCase.particlesCount; ++i)
+		{
+			const float x = ((i % columns) + 0.5f) * spacing + jitterDistr(engine);
+			const float y = ((i / columns) + 0.5f) * spacing + jitterDistr(engine);
+			positions[i] = glm::vec2(x, y);
+			velocities[i] = glm::vec2(vxDistr(engine), vyDistr(engine));
+		}
+	}
+
+	template<typename Function>
+	double measureUs(Function&& function, const std::uint32_t repetitions)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		for (std::uint32_t i = 0; i < repetitions; ++i)
+		{
+			function();
+		}
+		return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / repetitions;
+	}
+
+	double getPercentile(std::vector<double> values, const double percentile)
+	{
+		std::sort(values.begin(), values.end());
+		const std::size_t rank = static_cast<std::size_t>(ceil(percentile * values.size()));
+		return values[std::clamp<std::size_t>(rank, 1, values.size()) - 1];
+	}
+
+	template<typename Layout>
+	BenchmarkResult runBenchmarkCase(const BenchmarkCase& benchmarkCase, const SuiteOptions& options)
+	{
+		typename Layout::Vec2Array positions(benchmarkCase.particlesCount);
+		typename Layout::Vec2Array velocities(benchmarkCase.particlesCount);
+
+		BenchmarkResult result{};
+		result.benchmarkCase = benchmarkCase;
+		generateLatticeStart(positions, velocities, benchmarkCase, options.seed, result.xMax, result.yMax);
+
+		/*
+		Zero time step keeps the start state for doIteration.
+		*/
+		std::vector<float> xComponent(benchmarkCase.particlesCount), yComponent(benchmarkCase.particlesCount);
+		result.integrateUs = measureUs([&] {integratePositions(positions, velocities, 0.f);}, BULK_REPETITIONS_COUNT);
+		result.copyUs = measureUs([&] {copyComponents(velocities, xComponent.data(), yComponent.data());}, BULK_REPETITIONS_COUNT);
+
+		Physics<typename Layout::Vec2Array, typename Layout::Vec2Array> physics(positions, velocities, result.xMax, result.yMax, benchmarkCase.radius);
+		physics.initialize();
+		physics.setThreadsCount(options.threadsCount);
+		physics.setSubStepsCount(benchmarkCase.subStepsCount);
+		physics.setReorderInterval(benchmarkCase.reorderInterval);
+		physics.setNarrowPhaseKernel(getKernel(benchmarkCase.kernel));
+		for (std::uint32_t step = 0; step < options.warmupStepsCount; ++step)
+		{
+			physics.doIteration();
+		}
+
+		std::vector<double> stepMs;
+		std::array<std::vector<double>, PHYSICS_PHASES_COUNT> phaseMs;
+		const std::uint64_t startCollisionsCount = physics.getSimulationStats().collisionsCount;
+		for (std::uint32_t step = 0; step < options.stepsCount; ++step)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			physics.doIteration();
+			stepMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+			const SimulationStats& stats = physics.getSimulationStats();
+			for (std::uint32_t i = 0; i < PHYSICS_PHASES_COUNT; ++i)
+			{
+				phaseMs[i].push_back(stats.phaseDurations.ms[i]);
+			}
+		}
+
+		double totalMs = 0.0;
+		for (const double ms : stepMs)
+		{
+			totalMs += ms;
+		}
+		const std::uint64_t collisionsCount = physics.getSimulationStats().collisionsCount - startCollisionsCount;
+
+		result.medianMs = getPercentile(stepMs, 0.5);
+		result.p99Ms = getPercentile(stepMs, 0.99);
+		result.nsPerParticle = result.medianMs * 1e6 / benchmarkCase.particlesCount;
+		result.collisionsPerSecond = collisionsCount / (totalMs / 1000.0);
+		for (std::uint32_t i = 0; i < PHYSICS_PHASES_COUNT; ++i)
+		{
+			result.phaseMs[i] = getPercentile(phaseMs[i], 0.5);
+		}
+		result.indexGapBeforeReorder = physics.getSimulationStats().indexGapBeforeReorder;
+		result.indexGapAfterReorder = physics.getSimulationStats().indexGapAfterReorder;
+		return result;
+	}
+
+	void writeCsv(std::ostream& output, const std::vector<BenchmarkResult>& results)
+	{
+		output << "layout,kernel,reorder,particles,density,radius,substeps,width,height,median_ms,p99_ms,ns_per_particle,collisions_per_s,grid_clear_ms,integrate_bin_ms,interior_ms,boundary_ms,"
+			"integrate_positions_us,copy_components_us,index_gap_before,index_gap_after\n";
+		for (const BenchmarkResult& result : results)
+		{
+			const BenchmarkCase& c = result.benchmarkCase;
+			output << c.layout << ',' << c.kernel << ',' << c.reorderInterval << ',' << c.particlesCount << ',' << c.density << ',' << c.radius << ',' << c.subStepsCount << ','
+				<< result.xMax << ',' << result.yMax << ',' << result.medianMs << ',' << result.p99Ms << ',' << result.nsPerParticle << ','
+				<< result.collisionsPerSecond << ',' << result.phaseMs[0] << ',' << result.phaseMs[1] << ',' << result.phaseMs[2] << ',' << result.phaseMs[3] << ','
+				<< result.integrateUs << ',' << result.copyUs << ',' << result.indexGapBeforeReorder << ',' << result.indexGapAfterReorder << '\n';
+		}
+	}
+
+	void writeJson(std::ostream& output, const std::vector<BenchmarkResult>& results)
+	{
+		output << "[\n";
+		for (std::size_t i = 0; i < results.size(); ++i)
+		{
+			const BenchmarkResult& result = results[i];
+			const BenchmarkCase& c = result.benchmarkCase;
+			output << "  {\"layout\": \"" << c.layout << "\", \"kernel\": \"" << c.kernel << "\", \"reorder\": " << c.reorderInterval << ", \"particles\": " << c.particlesCount << ", \"density\": " << c.density
+				<< ", \"radius\": " << c.radius << ", \"substeps\": " << c.subStepsCount << ", \"width\": " << result.xMax << ", \"height\": " << result.yMax
+				<< ", \"median_ms\": " << result.medianMs << ", \"p99_ms\": " << result.p99Ms << ", \"ns_per_particle\": " << result.nsPerParticle
+				<< ", \"collisions_per_s\": " << result.collisionsPerSecond << ", \"grid_clear_ms\": " << result.phaseMs[0]
+				<< ", \"integrate_bin_ms\": " << result.phaseMs[1] << ", \"interior_ms\": " << result.phaseMs[2] << ", \"boundary_ms\": " << result.phaseMs[3]
+				<< ", \"integrate_positions_us\": " << result.integrateUs << ", \"copy_components_us\": " << result.copyUs
+				<< ", \"index_gap_before\": " << result.indexGapBeforeReorder << ", \"index_gap_after\": " << result.indexGapAfterReorder << "}"
+				<< (i + 1 < results.size() ? ",\n" : "\n");
+		}
+		output << "]\n";
+	}
+}
+
+int main(int argc, char** argv)
+{
+	SuiteOptions options;
+	if (!parseOptions(argc, argv, options))
+	{
+		return 1;
+	}
+	std::cerr << "Narrow phase kernel: " << getNarrowPhaseKernelName(detectNarrowPhaseKernel()) << "\n";
+
+	std::vector<BenchmarkResult> results;
+	for (const std::string& layout : options.layouts)
+	{
+		for (const std::uint32_t particlesCount : options.particlesCounts)
+		{
+			for (const float density : options.densities)
+			{
+				for (const float radius : options.radii)
+				{
+					for (const std::uint32_t subStepsCount : options.subStepsCounts)
+					{
+						for (const std::uint32_t reorderInterval : options.reorderIntervals)
+						{
+							for (const std::string& kernel : options.kernels)
+							{
+								const BenchmarkCase benchmarkCase{ layout, particlesCount, density, radius, subStepsCount, reorderInterval, kernel };
+								if (!(density > 0.f && density <= MAX_CIRCLE_DENSITY) || !(radius > 0.f) || particlesCount == 0 || subStepsCount == 0)
+								{
+									std::cerr << "Skipping invalid configuration: " << particlesCount << " particles, density " << density << ", radius " << radius << "\n";
+									continue;
+								}
+
+								std::cerr << layout << ", " << particlesCount << " particles, density " << density << ", radius " << radius << ", " << subStepsCount
+									<< " substeps, reorder interval " << reorderInterval << ", kernel " << kernel << "\n";
+								results.push_back(layout == "soa" ? runBenchmarkCase<SoaLayout>(benchmarkCase, options) : runBenchmarkCase<AosLayout>(benchmarkCase, options));
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	std::ofstream file;
+	if (!options.outputPath.empty())
+	{
+		file.open(options.outputPath);
+		if (!file)
+		{
+			std::cerr << "Can't open output file " << options.outputPath << "\n";
+			return 1;
+		}
+	}
+
+	std::ostream& output = options.outputPath.empty() ? std::cout : file;
+	if (options.json)
+	{
+		writeJson(output, results);
+	}
+	else
+	{
+		writeCsv(output, results);
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include "Checkpoint.hpp"
+
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+
+std::optional<CheckpointHeader> readCheckpointHeader(const std::string& path) noexcept
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		std::cout << "Can't open checkpoint " << path << "\n";
+		return std::nullopt;
+	}
+
+	CheckpointHeader header;
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != CHECKPOINT_MAGIC)
+	{
+		std::cout << path << " isn't a checkpoint\n";
+		return std::nullopt;
+	}
+	if (header.version != CHECKPOINT_VERSION)
+	{
+		std::cout << "Checkpoint version " << header.version << " isn't supported, expected " << CHECKPOINT_VERSION << "\n";
+		return std::nullopt;
+	}
+
+	std::error_code error;
+	const std::uint64_t fileSize = std::filesystem::file_size(path, error);
+	if (error || header.sectionsCount > MAX_CHECKPOINT_SECTIONS)
+	{
+		std::cout << "Checkpoint " << path << " is damaged\n";
+		return std::nullopt;
+	}
+	for (std::uint32_t i = 0; i < header.sectionsCount; ++i)
+	{
+		if (header.sectionOffsets[i] % MAPPING_GRANULARITY != 0 || header.sectionOffsets[i] > fileSize || header.sectionSizes[i] > fileSize - header.sectionOffsets[i])
+		{
+			std::cout << "Checkpoint " << path << " is damaged\n";
+			return std::nullopt;
+		}
+	}
+	return header;
+}
+
+bool readCheckpointSection(const std::string& path, const std::uint64_t offset, void* data, const std::uint64_t bytes) noexcept
+{
+	std::ifstream file(path, std::ios::binary);
+	file.seekg(static_cast<std::streamoff>(offset));
+	return static_cast<bool>(file.read(static_cast<char*>(data), static_cast<std::streamsize>(bytes)));
+}
+
+CheckpointWriter::CheckpointWriter(const std::string& path_, const CheckpointHeader& header_) :
+	path(path_), temporaryPath(path_ + ".tmp"), file(temporaryPath, std::ios::binary | std::ios::trunc), header(header_)
+{
+	header.magic = CHECKPOINT_MAGIC;
+	header.version = CHECKPOINT_VERSION;
+	header.sectionsCount = 0;
+	header.sectionOffsets = {};
+	header.sectionSizes = {};
+}
+
+bool CheckpointWriter::isOpen() const noexcept
+{
+	return file.is_open();
+}
+
+void CheckpointWriter::writeSection(const void* data, const std::uint64_t bytes)
+{
+	if (header.sectionsCount == MAX_CHECKPOINT_SECTIONS)
+	{
+		file.setstate(std::ios::failbit);
+		return;
+	}
+
+	header.sectionOffsets[header.sectionsCount] = nextOffset;
+	header.sectionSizes[header.sectionsCount] = bytes;
+	++header.sectionsCount;
+
+	file.seekp(static_cast<std::streamoff>(nextOffset));
+	file.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+	nextOffset += (bytes + MAPPING_GRANULARITY - 1) / MAPPING_GRANULARITY * MAPPING_GRANULARITY;
+}
+
+bool CheckpointWriter::finish()
+{
+	file.seekp(0);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.close();
+	if (!file)
+	{
+		std::cout << "Writing checkpoint " << temporaryPath << " failed\n";
+		return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, path, error);
+	if (error)
+	{
+		std::cout << "Can't replace checkpoint " << path << ": " << error.message() << "\n";
+		return false;
+	}
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include "MappedFile.hpp"
+#include "ParticleArrays.hpp"
+
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+
+constexpr std::uint32_t CHECKPOINT_VERSION = 1;
+constexpr std::uint32_t MAX_CHECKPOINT_SECTIONS = 8;
+
+/*
+Checkpoint file starts with this header, followed by raw arrays (sections) in the storage format of the layout:
+positions, velocities and stable particle ids. Every section starts at a multiple of MAPPING_GRANULARITY,
+so it can be mapped directly as particle storage. Values are stored in the byte order of the machine.
+*/
+struct CheckpointHeader
+{
+	std::array<char, 8> magic;
+	std::uint32_t version;
+	std::uint32_t layoutId;
+	std::uint32_t xMax;
+	std::uint32_t yMax;
+	float radius;
+	std::uint32_t particlesCount;
+	std::uint32_t seed;
+	std::uint32_t sectionsCount;
+	std::uint64_t iterationsCount;
+	std::array<std::uint64_t, MAX_CHECKPOINT_SECTIONS> sectionOffsets;
+	std::array<std::uint64_t, MAX_CHECKPOINT_SECTIONS> sectionSizes;
+};
+
+constexpr std::array<char, 8> CHECKPOINT_MAGIC = { '2', 'd', 'E', 'C', 'C', 'K', 'P', 'T' };
+
+/*
+Reads and validates the header, sections have to lie inside the file.
+*/
+std::optional<CheckpointHeader> readCheckpointHeader(const std::string& path) noexcept;
+bool readCheckpointSection(const std::string& path, const std::uint64_t offset, void* data, const std::uint64_t bytes) noexcept;
+
+/*
+Writes sections one after another to a temporary file, finish() adds the header and renames it to path.
+Replacing the file instead of overwriting it keeps checkpoints mapped by the running simulation intact.
+*/
+class CheckpointWriter
+{
+private:
+	const std::string path;
+	const std::string temporaryPath;
+	std::ofstream file;
+	CheckpointHeader header;
+	std::uint64_t nextOffset = MAPPING_GRANULARITY;
+
+public:
+	CheckpointWriter(const std::string& path_, const CheckpointHeader& header_);
+
+	bool isOpen() const noexcept;
+	void writeSection(const void* data, const std::uint64_t bytes);
+	bool finish();
+};
+
+/*
+Maps count values of the section as the new storage of the buffer, reads them into a new buffer when mapping isn't possible.
+The buffer is left unchanged when the section doesn't hold count values or can't be read.
+*/
+template<typename T>
+bool loadCheckpointSection(const std::string& path, const CheckpointHeader& header, const std::uint32_t section, const std::size_t count,
+	AlignedBuffer<T>& buffer)
+{
+	const std::uint64_t bytes = count * sizeof(T);
+	if (section >= header.sectionsCount || header.sectionSizes[section] != bytes)
+	{
+		return false;
+	}
+
+	if (std::optional<AlignedBuffer<T>> mapped = AlignedBuffer<T>::mapFile(path, header.sectionOffsets[section], count))
+	{
+		buffer = std::move(*mapped);
+		return true;
+	}
+	AlignedBuffer<T> read(count);
+	if (!readCheckpointSection(path, header.sectionOffsets[section], read.data(), bytes))
+	{
+		return false;
+	}
+	buffer = std::move(read);
+	return true;
+}
+
+#endif
\ No newline at end of file
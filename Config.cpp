@@ -0,0 +1,366 @@
+#include "Config.hpp"
+#include "Checkpoint.hpp"
+
+#include <charconv>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+	template<typename T>
+	bool parseNumber(const std::string_view text, T& value) noexcept
+	{
+		const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+		return error == std::errc() && end == text.data() + text.size();
+	}
+
+	std::string_view trim(std::string_view text) noexcept
+	{
+		const std::size_t begin = text.find_first_not_of(" \t\r");
+		if (begin == std::string_view::npos)
+		{
+			return {};
+		}
+		const std::size_t end = text.find_last_not_of(" \t\r");
+		return text.substr(begin, end - begin + 1);
+	}
+
+	bool parseBool(const std::string_view text, bool& value) noexcept
+	{
+		if (text == "1" || text == "true")
+		{
+			value = true;
+			return true;
+		}
+		if (text == "0" || text == "false")
+		{
+			value = false;
+			return true;
+		}
+		return false;
+	}
+
+	bool parseEngineType(const std::string_view text, PhysicsEngineType& value) noexcept
+	{
+		if (text == "time-stepping")
+		{
+			value = PhysicsEngineType::TimeStepping;
+			return true;
+		}
+		if (text == "event-driven")
+		{
+			value = PhysicsEngineType::EventDriven;
+			return true;
+		}
+		return false;
+	}
+
+	bool parseVelocityDistribution(const std::string_view text, VelocityDistribution& value) noexcept
+	{
+		if (text == "uniform")
+		{
+			value = VelocityDistribution::Uniform;
+			return true;
+		}
+		if (text == "maxwell-boltzmann")
+		{
+			value = VelocityDistribution::MaxwellBoltzmann;
+			return true;
+		}
+		return false;
+	}
+
+	bool parseCaptureFormat(const std::string_view text, CaptureFormat& value) noexcept
+	{
+		if (text == "ppm")
+		{
+			value = CaptureFormat::Ppm;
+			return true;
+		}
+		if (text == "raw")
+		{
+			value = CaptureFormat::Raw;
+			return true;
+		}
+		return false;
+	}
+
+	bool parseContextApi(const std::string_view text, ContextApi& value) noexcept
+	{
+		if (text == "native")
+		{
+			value = ContextApi::Native;
+			return true;
+		}
+		if (text == "surfaceless")
+		{
+			value = ContextApi::Surfaceless;
+			return true;
+		}
+		return false;
+	}
+}
+
+std::uint32_t WorldConfig::getParticlesCount() const noexcept
+{
+	return particlesCount != 0 ? particlesCount : getBallCount(xMax, yMax, radius, density);
+}
+
+bool setConfigValue(Config& config, const std::string_view key, const std::string_view value) noexcept
+{
+	bool parsed = false;
+	if (key == "width")
+	{
+		parsed = parseNumber(value, config.world.xMax);
+	}
+	else if (key == "height")
+	{
+		parsed = parseNumber(value, config.world.yMax);
+	}
+	else if (key == "radius")
+	{
+		parsed = parseNumber(value, config.world.radius);
+	}
+	else if (key == "density")
+	{
+		parsed = parseNumber(value, config.world.density);
+	}
+	else if (key == "particles")
+	{
+		parsed = parseNumber(value, config.world.particlesCount);
+	}
+	else if (key == "engine")
+	{
+		parsed = parseEngineType(value, config.settings.engineType);
+	}
+	else if (key == "threads")
+	{
+		parsed = parseNumber(value, config.settings.threadsCount);
+	}
+	else if (key == "substeps")
+	{
+		parsed = parseNumber(value, config.settings.subStepsCount) && config.settings.subStepsCount > 0;
+	}
+	else if (key == "neighbor-lists")
+	{
+		parsed = parseBool(value, config.settings.useNeighborLists);
+	}
+	else if (key == "reorder")
+	{
+		parsed = parseNumber(value, config.settings.reorderInterval);
+	}
+	else if (key == "density-field-ratio")
+	{
+		parsed = parseNumber(value, config.renderSettings.densityFieldRatio) && config.renderSettings.densityFieldRatio >= 0.f;
+	}
+	else if (key == "steps")
+	{
+		parsed = parseNumber(value, config.stepsCount);
+	}
+	else if (key == "seed")
+	{
+		parsed = parseNumber(value, config.seed);
+	}
+	else if (key == "velocities")
+	{
+		parsed = parseVelocityDistribution(value, config.velocityDistribution);
+	}
+	else if (key == "temperature")
+	{
+		parsed = parseNumber(value, config.temperature) && config.temperature > 0.f;
+	}
+	else if (key == "checksum")
+	{
+		parsed = parseNumber(value, config.checksumInterval);
+	}
+	else if (key == "timings")
+	{
+		parsed = parseNumber(value, config.timingsInterval);
+	}
+	else if (key == "restore")
+	{
+		config.restorePath = value;
+		parsed = !value.empty();
+	}
+	else if (key == "checkpoint")
+	{
+		config.checkpointPath = value;
+		parsed = !value.empty();
+	}
+	else if (key == "trajectory")
+	{
+		config.trajectoryPath = value;
+		parsed = !value.empty();
+	}
+	else if (key == "trajectory-interval")
+	{
+		parsed = parseNumber(value, config.trajectoryInterval) && config.trajectoryInterval > 0;
+	}
+	else if (key == "trajectory-bits")
+	{
+		parsed = parseNumber(value, config.trajectoryBits) && config.trajectoryBits >= 8 && config.trajectoryBits <= 30;
+	}
+	else if (key == "verify-trajectory")
+	{
+		config.verifyTrajectoryPath = value;
+		parsed = !value.empty();
+	}
+	else if (key == "capture")
+	{
+		config.capture.path = value;
+		parsed = !value.empty();
+	}
+	else if (key == "capture-format")
+	{
+		parsed = parseCaptureFormat(value, config.capture.format);
+	}
+	else if (key == "capture-interval")
+	{
+		parsed = parseNumber(value, config.capture.interval) && config.capture.interval > 0;
+	}
+	else if (key == "capture-frames")
+	{
+		parsed = parseNumber(value, config.capture.framesCount);
+	}
+	else if (key == "offscreen")
+	{
+		parsed = parseBool(value, config.capture.offscreen);
+	}
+	else if (key == "context")
+	{
+		parsed = parseContextApi(value, config.capture.contextApi);
+	}
+	else if (key == "profile")
+	{
+		config.profilePath = value;
+		parsed = !value.empty();
+	}
+	else
+	{
+		std::cout << "Unknown option: " << key << "\n";
+		return false;
+	}
+
+	if (!parsed)
+	{
+		std::cout << "Invalid value of " << key << ": " << value << "\n";
+	}
+	return parsed;
+}
+
+bool loadConfigFile(const std::string& path, Config& config) noexcept
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		std::cout << "Can't open config file " << path << "\n";
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		const std::string_view text = trim(line);
+		if (text.empty() || text.front() == '#')
+		{
+			continue;
+		}
+
+		const std::size_t separator = text.find('=');
+		if (separator == std::string_view::npos)
+		{
+			std::cout << "Expected key = value in " << path << ": " << text << "\n";
+			return false;
+		}
+		if (!setConfigValue(config, trim(text.substr(0, separator)), trim(text.substr(separator + 1))))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool validateConfig(const Config& config) noexcept
+{
+	const WorldConfig& world = config.world;
+	if (!(world.radius > 0.f) || !(world.density > 0.f))
+	{
+		std::cout << "Radius and density have to be positive\n";
+		return false;
+	}
+	if (world.xMax < 4.f * world.radius || world.yMax < 4.f * world.radius)
+	{
+		std::cout << "World has to be at least two circle diameters wide and high\n";
+		return false;
+	}
+
+	const double density = 100.0 * 4.0 * world.radius * world.radius * world.getParticlesCount() / (static_cast<double>(world.xMax) * world.yMax);
+	if (density > MAX_CIRCLE_DENSITY)
+	{
+		std::cout << "Density " << density << " exceeds " << MAX_CIRCLE_DENSITY << ", circles can't be placed without overlaps\n";
+		return false;
+	}
+	if (world.getParticlesCount() == 0)
+	{
+		std::cout << "World has no particles\n";
+		return false;
+	}
+	if (config.capture.offscreen && (config.capture.path.empty() || config.capture.framesCount == 0))
+	{
+		std::cout << "Offscreen rendering needs capture and capture-frames\n";
+		return false;
+	}
+	if (config.capture.contextApi == ContextApi::Surfaceless && !config.capture.offscreen)
+	{
+		std::cout << "Surfaceless context has no window, it needs offscreen\n";
+		return false;
+	}
+	return true;
+}
+
+std::optional<Config> parseConfig(const int argc, const char* const* argv) noexcept
+{
+	Config config;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (std::string_view(argv[i]) == "--config" && !loadConfigFile(argv[i + 1], config))
+		{
+			return std::nullopt;
+		}
+	}
+
+	for (int i = 1; i < argc; i += 2)
+	{
+		const std::string_view key = argv[i];
+		if (!key.starts_with("--") || i + 1 == argc)
+		{
+			std::cout << "Expected --key value, got: " << key << "\n";
+			return std::nullopt;
+		}
+		if (key != "--config" && !setConfigValue(config, key.substr(2), argv[i + 1]))
+		{
+			return std::nullopt;
+		}
+	}
+
+	if (!config.restorePath.empty())
+	{
+		const std::optional<CheckpointHeader> header = readCheckpointHeader(config.restorePath);
+		if (!header)
+		{
+			return std::nullopt;
+		}
+		config.world.xMax = header->xMax;
+		config.world.yMax = header->yMax;
+		config.world.radius = header->radius;
+		config.world.particlesCount = header->particlesCount;
+		config.seed = header->seed;
+	}
+
+	if (!validateConfig(config))
+	{
+		return std::nullopt;
+	}
+	config.settings.neighborListSkin = config.world.radius;
+	return config;
+}
\ No newline at end of file
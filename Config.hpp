@@ -0,0 +1,106 @@
+#ifndef CONFIG_HPP
+#define CONFIG_HPP
+
+#include "Constants.hpp"
+#include "SimulationSettings.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+
+/*
+Size of the simulated world chosen at startup. Particles count is derived from density
+unless particlesCount is given explicitly.
+*/
+struct WorldConfig
+{
+	std::uint32_t xMax = DEFAULT_X_MAX;
+	std::uint32_t yMax = DEFAULT_Y_MAX;
+	float radius = DEFAULT_CIRCLE_RADIUS;
+	float density = DEFAULT_CIRCLE_DENSITY;
+	std::uint32_t particlesCount = 0;
+
+	std::uint32_t getParticlesCount() const noexcept;
+};
+
+enum class CaptureFormat : std::uint8_t
+{
+	Ppm,
+	Raw
+};
+
+enum class ContextApi : std::uint8_t
+{
+	Native,
+	Surfaceless
+};
+
+/*
+Frame capture of the windowed build, a frame is captured every interval iterations. Path "-" streams raw RGB frames
+to stdout, otherwise every frame is written to its own file path_IIIIIIII.ppm or .rgb named by its iteration.
+Offscreen rendering draws into a framebuffer object of a hidden window, or of a surfaceless context without any window,
+and stops after framesCount captured frames.
+*/
+struct CaptureConfig
+{
+	std::string path;
+	CaptureFormat format = CaptureFormat::Ppm;
+	std::uint32_t interval = 1;
+	std::uint32_t framesCount = 0;
+	bool offscreen = false;
+	ContextApi contextApi = ContextApi::Native;
+};
+
+/*
+Everything chosen at startup: the world, initial simulation settings (later editable in the control panel)
+and options of the headless runner.
+*/
+struct Config
+{
+	WorldConfig world;
+	SimulationSettings settings;
+	RenderSettings renderSettings;
+	CaptureConfig capture;
+	std::uint32_t stepsCount = 1000;
+	std::uint32_t seed = std::random_device{}();
+	VelocityDistribution velocityDistribution = VelocityDistribution::Uniform;
+	float temperature = DEFAULT_TEMPERATURE;
+	std::uint32_t checksumInterval = 0;
+	std::uint32_t timingsInterval = 0;
+	std::string profilePath;
+	std::string restorePath;
+	std::string checkpointPath;
+	std::string trajectoryPath;
+	std::uint32_t trajectoryInterval = 10;
+	std::uint32_t trajectoryBits = 16;
+	std::string verifyTrajectoryPath;
+};
+
+/*
+Options are read from "--key value" arguments, "--config path" loads "key = value" lines from a file
+first and the remaining arguments override it. Lines starting with '#' are comments.
+World keys: width, height, radius, density, particles.
+Simulation keys: engine (time-stepping or event-driven), threads, substeps, neighbor-lists (0 or 1), reorder.
+Start state keys: seed (random unless given), velocities (uniform or maxwell-boltzmann), temperature (of maxwell-boltzmann velocities).
+Checkpoint keys: restore (start from a checkpoint, its world and seed replace the world keys),
+checkpoint (save the state to the given path at exit).
+Trajectory keys: trajectory (path of the compressed trajectory stream), trajectory-interval (write every given number of steps),
+trajectory-bits (fixed point precision of positions, 8 to 30).
+Window keys: density-field-ratio (particles per pixel above which a density field is drawn instead of particles).
+Capture keys: capture (path prefix of captured frames or - for raw frames on stdout), capture-format (ppm or raw),
+capture-interval (capture every given number of iterations), capture-frames (stop after the given number of frames, 0 doesn't stop),
+offscreen (0 or 1, render into a hidden framebuffer, needs capture-frames),
+context (native or surfaceless, an EGL context without window and display, needs offscreen).
+Profiler keys: profile (record zones from the start and write a Chrome trace to the given path at exit).
+Headless keys: steps, checksum (print state summary every given number of steps, 0 disables),
+timings (print phase time percentiles every given number of steps, 0 disables),
+verify-trajectory (path of a trajectory written by a run with the same options, its frames are decoded and compared with the state).
+*/
+std::optional<Config> parseConfig(const int argc, const char* const* argv) noexcept;
+bool loadConfigFile(const std::string& path, Config& config) noexcept;
+bool setConfigValue(Config& config, const std::string_view key, const std::string_view value) noexcept;
+bool validateConfig(const Config& config) noexcept;
+
+#endif
\ No newline at end of file
@@ -3,20 +3,43 @@
 
 #include <cstdint>
 
-inline constexpr std::uint32_t CIRCLE_DENSITY = 30;
-inline constexpr std::uint32_t CIRCLE_RADIUS = 2;
+/*
+Defaults of WorldConfig, every one of them can be changed at runtime.
+*/
+inline constexpr std::uint32_t DEFAULT_X_MAX = 1600;
+inline constexpr std::uint32_t DEFAULT_Y_MAX = 900;
+inline constexpr float DEFAULT_CIRCLE_DENSITY = 30.f;
+inline constexpr float DEFAULT_CIRCLE_RADIUS = 2.f;
+
+/*
+Random non overlapping placement jams at about 70% density and slows down well before that,
+denser worlds are spawned on a jittered lattice which fits at most 100%.
+*/
+inline constexpr float MAX_RANDOM_SPAWN_DENSITY = 60.f;
+inline constexpr float MAX_CIRCLE_DENSITY = 85.f;
 
 inline constexpr float vxMax = 25.f, vyMax = 25.f, vxMin = -25.f, vyMin = -25.f;
 
+/*
+Temperature (with unit mass and Boltzmann constant) equal to the variance of a uniform velocity component,
+so both start distributions have the same mean energy.
+*/
+inline constexpr float DEFAULT_TEMPERATURE = (vxMax - vxMin) * (vxMax - vxMin) / 12.f;
+
 inline constexpr float DELTA_T = 0.05f;
 
-inline constexpr std::uint32_t TRIANGLES_PER_CIRCLE = 16;
-inline constexpr std::uint32_t VERTICES_PER_CIRCLE = 3 * (TRIANGLES_PER_CIRCLE - 2);
+/*
+Side of a density field texel in pixels of the window.
+*/
+inline constexpr float DENSITY_FIELD_TEXEL_PIXELS = 2.f;
 
-consteval std::uint32_t getBallCount(const std::uint32_t xMax, const std::uint32_t yMax)
+/*
+Density is the percentage of the area covered by squares circumscribed on circles.
+*/
+constexpr std::uint32_t getBallCount(const std::uint32_t xMax, const std::uint32_t yMax, const float radius, const float density)
 {
-	auto windowArea = xMax * yMax;
-	return (CIRCLE_DENSITY * windowArea) / (100 * 4 * CIRCLE_RADIUS * CIRCLE_RADIUS);
+	const double windowArea = static_cast<double>(xMax) * yMax;
+	return static_cast<std::uint32_t>(density * windowArea / (100.0 * 4.0 * radius * radius));
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,76 @@
+#ifndef DENSITYFIELD_HPP
+#define DENSITYFIELD_HPP
+
+#include "Grid.hpp"
+
+#include <glm/vec2.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/*
+Coarse field drawn instead of particles when they are smaller than pixels. Particles are binned into cells
+of a Grid2d whose cells are the texels of the field, every texel holds the number of particles relative to the mean
+and the thermal speed, the root mean square speed relative to the mean velocity of the texel.
+*/
+class DensityField
+{
+private:
+	Grid2d grid;
+	const std::uint32_t width;
+	const std::uint32_t height;
+	std::vector<std::uint32_t> counts;
+	std::vector<glm::vec2> velocitySums;
+	std::vector<float> squaredSpeedSums;
+
+public:
+	DensityField(const std::uint32_t xMax, const std::uint32_t yMax, const float texelSize) noexcept : grid(xMax, yMax, 0.5f * texelSize),
+		width(grid.getXCellsCount()), height(grid.getYCellsCount()), counts(width * height), velocitySums(width * height), squaredSpeedSums(width * height)
+	{
+	}
+
+	std::uint32_t getWidth() const noexcept
+	{
+		return width;
+	}
+
+	std::uint32_t getHeight() const noexcept
+	{
+		return height;
+	}
+
+	template<typename PosArrType, typename VelArrType>
+	void build(const PosArrType& positions, const VelArrType& velocities, std::vector<glm::vec2>& texels) noexcept
+	{
+		std::fill(counts.begin(), counts.end(), 0);
+		std::fill(velocitySums.begin(), velocitySums.end(), glm::vec2(0.f));
+		std::fill(squaredSpeedSums.begin(), squaredSpeedSums.end(), 0.f);
+		for (std::uint32_t i = 0; i < positions.size(); ++i)
+		{
+			const std::uint32_t texel = grid.getCellId(positions[i]);
+			const glm::vec2 velocity = velocities[i];
+			++counts[texel];
+			velocitySums[texel] += velocity;
+			squaredSpeedSums[texel] += glm::dot(velocity, velocity);
+		}
+
+		const float meanCount = static_cast<float>(positions.size()) / counts.size();
+		texels.resize(counts.size());
+		for (std::uint32_t i = 0; i < counts.size(); ++i)
+		{
+			if (counts[i] == 0)
+			{
+				texels[i] = glm::vec2(0.f);
+				continue;
+			}
+			const glm::vec2 meanVelocity = velocitySums[i] / static_cast<float>(counts[i]);
+			const float meanSquaredSpeed = squaredSpeedSums[i] / counts[i];
+			texels[i] = glm::vec2(counts[i] / meanCount, std::sqrt(std::max(0.f, meanSquaredSpeed - glm::dot(meanVelocity, meanVelocity))));
+		}
+	}
+};
+
+#endif
\ No newline at end of file
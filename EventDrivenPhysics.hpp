@@ -0,0 +1,413 @@
+#ifndef EVENTDRIVENPHYSICS_HPP
+#define EVENTDRIVENPHYSICS_HPP
+
+#include "Constants.hpp"
+#include "Grid.hpp"
+#include "PhaseTimings.hpp"
+#include "SimulationSettings.hpp"
+
+#include <glm/vec2.hpp>
+#include <glm/geometric.hpp>
+
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <vector>
+
+/*
+Event driven hard disks engine. Instead of fixed substeps, exact times of the next pair collision,
+wall collision and grid cell crossing are predicted for every particle and kept in a priority queue.
+Particles are advanced lazily: positions[i] is valid at particleTimes[i], they are synchronized
+to the common time only at the end of doIteration.
+Events carry collision counters of involved particles, an event is stale when any of them changed.
+*/
+template<typename PosArrType, typename VelArrType>
+class EventDrivenPhysics
+{
+private:
+	enum class EventType : std::uint8_t
+	{
+		PairCollision,
+		WallCollisionX,
+		WallCollisionY,
+		CellCrossingX,
+		CellCrossingY
+	};
+
+	struct Event
+	{
+		double time;
+		std::uint32_t i;
+		std::uint32_t j;
+		std::uint32_t counterI;
+		std::uint32_t counterJ;
+		EventType type;
+
+		bool operator>(const Event& other) const noexcept
+		{
+			return time > other.time;
+		}
+	};
+
+	static constexpr std::uint32_t NO_PARTICLE = std::numeric_limits<std::uint32_t>::max();
+	static constexpr double NEVER = std::numeric_limits<double>::infinity();
+
+	PosArrType& positions;
+	VelArrType& velocities;
+
+	const std::uint32_t xMax;
+	const std::uint32_t yMax;
+	const float radius;
+	const float diameterSquared;
+
+	Grid2d grid;
+	std::uint32_t columns = 0;
+	std::uint32_t rows = 0;
+
+	std::vector<std::uint32_t> cellHeads;
+	std::vector<std::uint32_t> nextInCell;
+	std::vector<std::uint32_t> prevInCell;
+	std::vector<std::uint32_t> particleCells;
+
+	std::vector<double> particleTimes;
+	std::vector<std::uint32_t> collisionCounters;
+	std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+
+	double currentTime = 0.0;
+	std::uint64_t processedEventsCount = 0;
+	SimulationStats stats;
+
+	glm::vec2 positionAt(const std::uint32_t i, const double time) const noexcept
+	{
+		return positions[i] + static_cast<float>(time - particleTimes[i]) * velocities[i];
+	}
+
+	void advance(const std::uint32_t i, const double time) noexcept
+	{
+		positions[i] = positionAt(i, time);
+		particleTimes[i] = time;
+	}
+
+	void insertToCell(const std::uint32_t i, const std::uint32_t cellId) noexcept
+	{
+		particleCells[i] = cellId;
+		prevInCell[i] = NO_PARTICLE;
+		nextInCell[i] = cellHeads[cellId];
+		if (cellHeads[cellId] != NO_PARTICLE)
+		{
+			prevInCell[cellHeads[cellId]] = i;
+		}
+		cellHeads[cellId] = i;
+	}
+
+	void removeFromCell(const std::uint32_t i) noexcept
+	{
+		if (prevInCell[i] != NO_PARTICLE)
+		{
+			nextInCell[prevInCell[i]] = nextInCell[i];
+		}
+		else
+		{
+			cellHeads[particleCells[i]] = nextInCell[i];
+		}
+
+		if (nextInCell[i] != NO_PARTICLE)
+		{
+			prevInCell[nextInCell[i]] = prevInCell[i];
+		}
+	}
+
+	double getWallTime(const float position, const float velocity, const std::uint32_t max) const noexcept
+	{
+		double wallTime = NEVER;
+		if (velocity > 0.f)
+		{
+			wallTime = (max - radius - position) / velocity;
+		}
+		else if (velocity < 0.f)
+		{
+			wallTime = (radius - position) / velocity;
+		}
+		return wallTime > 0.0 ? wallTime : 0.0;
+	}
+
+	/*
+	Time until the particle leaves its cell through one of the cell edges perpendicular to the given axis,
+	crossings towards outside of the grid are never scheduled, wall collision comes first.
+	*/
+	double getCellCrossingTime(const float position, const float velocity, const std::uint32_t cellCoord, const std::uint32_t cellsCount, const float cellLen) const noexcept
+	{
+		double crossingTime = NEVER;
+		if (velocity > 0.f && cellCoord + 1 < cellsCount)
+		{
+			crossingTime = ((cellCoord + 1) * cellLen - position) / velocity;
+		}
+		else if (velocity < 0.f && cellCoord > 0)
+		{
+			crossingTime = (cellCoord * cellLen - position) / velocity;
+		}
+		return crossingTime > 0.0 ? crossingTime : 0.0;
+	}
+
+	/*
+	Solves |dr + t * dv| = 2 * radius for the earliest t >= 0, overlapping approaching pair collides immediately.
+	*/
+	double getPairCollisionTime(const glm::vec2 dr, const glm::vec2 dv) const noexcept
+	{
+		const float b = glm::dot(dr, dv);
+		if (b >= 0.f)
+		{
+			return NEVER;
+		}
+
+		const float dvSquared = glm::dot(dv, dv);
+		const float c = glm::dot(dr, dr) - diameterSquared;
+		if (c <= 0.f)
+		{
+			return 0.0;
+		}
+
+		const float discriminant = b * b - dvSquared * c;
+		if (discriminant <= 0.f)
+		{
+			return NEVER;
+		}
+		return c / (-b + sqrtf(discriminant));
+	}
+
+	void predictEvents(const std::uint32_t i) noexcept
+	{
+		const glm::vec2 position = positions[i];
+		const glm::vec2 velocity = velocities[i];
+		const std::uint32_t xCell = particleCells[i] % columns;
+		const std::uint32_t yCell = particleCells[i] / columns;
+
+		const double wallTimeX = getWallTime(position.x, velocity.x, xMax);
+		const double wallTimeY = getWallTime(position.y, velocity.y, yMax);
+		const double crossingTimeX = getCellCrossingTime(position.x, velocity.x, xCell, columns, grid.getXLen());
+		const double crossingTimeY = getCellCrossingTime(position.y, velocity.y, yCell, rows, grid.getYLen());
+
+		double horizon = wallTimeX;
+		EventType type = EventType::WallCollisionX;
+		if (wallTimeY < horizon)
+		{
+			horizon = wallTimeY;
+			type = EventType::WallCollisionY;
+		}
+		if (crossingTimeX < horizon)
+		{
+			horizon = crossingTimeX;
+			type = EventType::CellCrossingX;
+		}
+		if (crossingTimeY < horizon)
+		{
+			horizon = crossingTimeY;
+			type = EventType::CellCrossingY;
+		}
+
+		if (horizon != NEVER)
+		{
+			events.push({ currentTime + horizon, i, NO_PARTICLE, collisionCounters[i], 0, type });
+		}
+
+		/*
+		Pair collisions later than the particle's own wall or cell event are dropped,
+		they are predicted again when that event is processed.
+		*/
+		for (std::uint32_t y = yCell > 0 ? yCell - 1 : 0; y <= yCell + 1 && y < rows; ++y)
+		{
+			for (std::uint32_t x = xCell > 0 ? xCell - 1 : 0; x <= xCell + 1 && x < columns; ++x)
+			{
+				for (std::uint32_t j = cellHeads[x + y * columns]; j != NO_PARTICLE; j = nextInCell[j])
+				{
+					if (j == i)
+					{
+						continue;
+					}
+
+					const double collisionTime = getPairCollisionTime(position - positionAt(j, currentTime), velocity - velocities[j]);
+					if (collisionTime <= horizon)
+					{
+						events.push({ currentTime + collisionTime, i, j, collisionCounters[i], collisionCounters[j], EventType::PairCollision });
+					}
+				}
+			}
+		}
+	}
+
+	bool isStale(const Event& event) const noexcept
+	{
+		if (event.counterI != collisionCounters[event.i])
+		{
+			return true;
+		}
+		return event.type == EventType::PairCollision && event.counterJ != collisionCounters[event.j];
+	}
+
+	void processPairCollision(const std::uint32_t i, const std::uint32_t j) noexcept
+	{
+		advance(i, currentTime);
+		advance(j, currentTime);
+
+		const glm::vec2 dr = positions[i] - positions[j];
+		const glm::vec2 impulse = glm::dot(velocities[i] - velocities[j], dr) / glm::dot(dr, dr) * dr;
+		velocities[i] -= impulse;
+		velocities[j] += impulse;
+
+		++collisionCounters[i];
+		++collisionCounters[j];
+		predictEvents(i);
+		predictEvents(j);
+	}
+
+	void processWallCollision(const std::uint32_t i, const EventType type) noexcept
+	{
+		advance(i, currentTime);
+		if (type == EventType::WallCollisionX)
+		{
+			velocities[i].x = -velocities[i].x;
+		}
+		else
+		{
+			velocities[i].y = -velocities[i].y;
+		}
+
+		++collisionCounters[i];
+		predictEvents(i);
+	}
+
+	void processCellCrossing(const std::uint32_t i, const EventType type) noexcept
+	{
+		advance(i, currentTime);
+
+		std::uint32_t newCellId = particleCells[i];
+		if (type == EventType::CellCrossingX)
+		{
+			newCellId = velocities[i].x > 0.f ? newCellId + 1 : newCellId - 1;
+		}
+		else
+		{
+			newCellId = velocities[i].y > 0.f ? newCellId + columns : newCellId - columns;
+		}
+		removeFromCell(i);
+		insertToCell(i, newCellId);
+
+		/*
+		Counter is bumped to drop collisions predicted from the old cell, all of them are
+		predicted again against neighbours of the new one.
+		*/
+		++collisionCounters[i];
+		predictEvents(i);
+	}
+
+	void rebuildEvents() noexcept
+	{
+		events = {};
+		for (std::uint32_t i = 0; i < positions.size(); ++i)
+		{
+			advance(i, currentTime);
+		}
+		for (std::uint32_t i = 0; i < positions.size(); ++i)
+		{
+			predictEvents(i);
+		}
+	}
+
+public:
+	EventDrivenPhysics(PosArrType& positions_, VelArrType& velocities_, const std::uint32_t xMax_, const std::uint32_t yMax_, const float radius_) noexcept :
+		positions(positions_), velocities(velocities_), xMax(xMax_), yMax(yMax_), radius(radius_), diameterSquared(4.f * radius_ * radius_), grid(xMax, yMax, radius)
+	{
+	}
+
+	/*
+	Builds cell lists and the event queue from the current state, has to be called whenever
+	positions or velocities were changed outside of this engine.
+	*/
+	void initialize()
+	{
+		columns = grid.getXCellsCount();
+		rows = grid.getYCellsCount();
+		const std::uint32_t particlesCount = static_cast<std::uint32_t>(positions.size());
+
+		cellHeads.assign(columns * rows, NO_PARTICLE);
+		nextInCell.assign(particlesCount, NO_PARTICLE);
+		prevInCell.assign(particlesCount, NO_PARTICLE);
+		particleCells.assign(particlesCount, 0);
+		particleTimes.assign(particlesCount, 0.0);
+		collisionCounters.assign(particlesCount, 0);
+		currentTime = 0.0;
+
+		for (std::uint32_t i = 0; i < particlesCount; ++i)
+		{
+			insertToCell(i, grid.getCellId(positions[i]));
+		}
+		rebuildEvents();
+	}
+
+	void doIteration() noexcept
+	{
+		const double targetTime = currentTime + DELTA_T;
+		stats.phaseDurations = {};
+
+		{
+			ScopedTimer timer(stats.phaseDurations, Phase::Events);
+			while (!events.empty() && events.top().time <= targetTime)
+			{
+				const Event event = events.top();
+				events.pop();
+				if (isStale(event))
+				{
+					continue;
+				}
+
+				currentTime = event.time;
+				++processedEventsCount;
+				switch (event.type)
+				{
+				case EventType::PairCollision:
+					processPairCollision(event.i, event.j);
+					++stats.collisionsCount;
+					break;
+				case EventType::WallCollisionX:
+				case EventType::WallCollisionY:
+					processWallCollision(event.i, event.type);
+					break;
+				case EventType::CellCrossingX:
+				case EventType::CellCrossingY:
+					processCellCrossing(event.i, event.type);
+					break;
+				}
+			}
+		}
+
+		ScopedTimer timer(stats.phaseDurations, Phase::EventSync);
+		currentTime = targetTime;
+		for (std::uint32_t i = 0; i < positions.size(); ++i)
+		{
+			advance(i, currentTime);
+		}
+
+		constexpr std::size_t STALE_EVENTS_FACTOR = 16;
+		if (events.size() > STALE_EVENTS_FACTOR * positions.size())
+		{
+			rebuildEvents();
+		}
+	}
+
+	std::uint64_t getProcessedEventsCount() const noexcept
+	{
+		return processedEventsCount;
+	}
+
+	/*
+	Durations of processing events and synchronizing particles to the common time in the last iteration,
+	pair collisions are counted like in the time stepping engine.
+	*/
+	const SimulationStats& getSimulationStats() const noexcept
+	{
+		return stats;
+	}
+};
+
+#endif
@@ -0,0 +1,204 @@
+#include "FrameCapture.hpp"
+#include "StreamBuffer.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace
+{
+	constexpr std::uint32_t BYTES_PER_PIXEL = 4;
+
+	bool writeToStdout(const void* data, const std::size_t bytes) noexcept
+	{
+		return std::fwrite(data, 1, bytes, stdout) == bytes;
+	}
+}
+
+FrameCapture::FrameCapture(const CaptureConfig& config_) : config(config_)
+{
+}
+
+FrameCapture::~FrameCapture()
+{
+	writer.stop();
+}
+
+bool FrameCapture::initialize(const GLsizei width_, const GLsizei height_)
+{
+	width = width_;
+	height = height_;
+	rgbRow.resize(3 * static_cast<std::size_t>(width));
+
+	if (config.offscreen)
+	{
+		glGenRenderbuffers(1, &colorRenderbuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, colorRenderbuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glGenFramebuffers(1, &framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRenderbuffer);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cout << "Offscreen framebuffer is incomplete\n";
+			return false;
+		}
+	}
+
+	const GLsizeiptr frameBytes = static_cast<GLsizeiptr>(BYTES_PER_PIXEL) * width * height;
+	glGenBuffers(PIXEL_BUFFERS_COUNT, pixelBuffers.data());
+	for (const GLuint pixelBuffer : pixelBuffers)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes, nullptr, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	if (config.path == "-")
+	{
+#ifdef _WIN32
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		std::cout << "Capturing " << width << "x" << height << " rgb24 frames to stdout\n";
+	}
+	else
+	{
+		std::cout << "Capturing " << width << "x" << height << " frames to " << config.path << "_<iteration>"
+			<< (config.format == CaptureFormat::Ppm ? ".ppm" : ".rgb") << "\n";
+	}
+	writer.start([this](const Frame& frame) { return writeFrame(frame); });
+	return true;
+}
+
+void FrameCapture::bindFramebuffer() noexcept
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	if (config.offscreen)
+	{
+		glViewport(0, 0, width, height);
+	}
+}
+
+void FrameCapture::captureFrame(const std::uint64_t iteration) noexcept
+{
+	if (isFinished() || iteration < nextIteration)
+	{
+		return;
+	}
+	nextIteration = (iteration / config.interval + 1) * config.interval;
+
+	const std::uint32_t buffer = capturedFramesCount % PIXEL_BUFFERS_COUNT;
+	if (fences[buffer] != nullptr)
+	{
+		retrieveFrame(buffer);
+	}
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glReadBuffer(config.offscreen ? GL_COLOR_ATTACHMENT0 : GL_BACK);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[buffer]);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	fences[buffer] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	bufferedIterations[buffer] = iteration;
+	++capturedFramesCount;
+}
+
+bool FrameCapture::isFinished() const noexcept
+{
+	return config.framesCount != 0 && capturedFramesCount >= config.framesCount;
+}
+
+void FrameCapture::retrieveFrame(const std::uint32_t buffer) noexcept
+{
+	waitForFence(fences[buffer]);
+
+	const std::size_t frameBytes = static_cast<std::size_t>(BYTES_PER_PIXEL) * width * height;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[buffer]);
+	if (const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(frameBytes), GL_MAP_READ_BIT))
+	{
+		std::unique_ptr<Frame> frame = writer.takeFreeItem();
+		frame->iteration = bufferedIterations[buffer];
+		frame->pixels.resize(frameBytes);
+		std::memcpy(frame->pixels.data(), pixels, frameBytes);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		writer.queueItem(std::move(frame));
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void FrameCapture::cleanup()
+{
+	for (std::uint32_t i = 0; i < PIXEL_BUFFERS_COUNT; ++i)
+	{
+		const std::uint32_t buffer = (capturedFramesCount + i) % PIXEL_BUFFERS_COUNT;
+		if (fences[buffer] != nullptr)
+		{
+			retrieveFrame(buffer);
+		}
+	}
+
+	const bool written = writer.stop();
+	if (config.path == "-")
+	{
+		std::fflush(stdout);
+	}
+	if (!written)
+	{
+		std::cout << "Writing captured frames failed\n";
+	}
+	else
+	{
+		std::cout << "Captured " << capturedFramesCount << " frames\n";
+	}
+
+	glDeleteBuffers(PIXEL_BUFFERS_COUNT, pixelBuffers.data());
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(1, &colorRenderbuffer);
+}
+
+/*
+Rows are read bottom up, they are written top down as RGB.
+*/
+bool FrameCapture::writeFrame(const Frame& frame)
+{
+	std::ofstream file;
+	if (config.path != "-")
+	{
+		std::ostringstream path;
+		path << config.path << "_" << std::setw(8) << std::setfill('0') << frame.iteration << (config.format == CaptureFormat::Ppm ? ".ppm" : ".rgb");
+		file.open(path.str(), std::ios::binary | std::ios::trunc);
+		if (config.format == CaptureFormat::Ppm)
+		{
+			file << "P6\n" << width << " " << height << "\n255\n";
+		}
+	}
+
+	bool written = config.path == "-" || static_cast<bool>(file);
+	for (GLsizei y = height - 1; y >= 0 && written; --y)
+	{
+		const std::uint8_t* pixel = frame.pixels.data() + static_cast<std::size_t>(BYTES_PER_PIXEL) * width * y;
+		for (GLsizei x = 0; x < width; ++x, pixel += BYTES_PER_PIXEL)
+		{
+			std::memcpy(rgbRow.data() + 3 * x, pixel, 3);
+		}
+		if (config.path == "-")
+		{
+			written = writeToStdout(rgbRow.data(), rgbRow.size());
+		}
+		else
+		{
+			written = static_cast<bool>(file.write(reinterpret_cast<const char*>(rgbRow.data()), static_cast<std::streamsize>(rgbRow.size())));
+		}
+	}
+	return written;
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#ifndef FRAMECAPTURE_HPP
+#define FRAMECAPTURE_HPP
+
+#include <GL/glew.h>
+
+#include "BackgroundWriter.hpp"
+#include "Config.hpp"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+/*
+Frames are read back asynchronously through a ring of pixel buffer objects: glReadPixels of a frame only queues
+a copy into the next buffer of the ring, which is mapped PIXEL_BUFFERS_COUNT captures later, when the GPU is long done.
+Mapped pixels are handed to a writer thread that flips and converts them to RGB and writes them out.
+At most MAX_QUEUED_FRAMES wait for the writer, capturing more blocks the render thread (not physics) until one is written.
+*/
+class FrameCapture
+{
+private:
+	static constexpr std::uint32_t PIXEL_BUFFERS_COUNT = 3;
+	static constexpr std::uint32_t MAX_QUEUED_FRAMES = 8;
+
+	struct Frame
+	{
+		std::uint64_t iteration = 0;
+		std::vector<std::uint8_t> pixels;
+	};
+
+	const CaptureConfig config;
+	GLsizei width = 0;
+	GLsizei height = 0;
+	GLuint framebuffer = 0;
+	GLuint colorRenderbuffer = 0;
+	std::array<GLuint, PIXEL_BUFFERS_COUNT> pixelBuffers{};
+	std::array<GLsync, PIXEL_BUFFERS_COUNT> fences{};
+	std::array<std::uint64_t, PIXEL_BUFFERS_COUNT> bufferedIterations{};
+	std::uint64_t nextIteration = 0;
+	std::uint64_t capturedFramesCount = 0;
+
+	std::vector<std::uint8_t> rgbRow;
+	BackgroundWriter<Frame> writer{ MAX_QUEUED_FRAMES };
+
+	void retrieveFrame(const std::uint32_t buffer) noexcept;
+	bool writeFrame(const Frame& frame);
+
+public:
+	explicit FrameCapture(const CaptureConfig& config_);
+	~FrameCapture();
+
+	FrameCapture(const FrameCapture&) = delete;
+	FrameCapture& operator=(const FrameCapture&) = delete;
+
+	/*
+	Creates pixel buffers of the given size and, when rendering offscreen, a framebuffer object of the same size.
+	*/
+	bool initialize(const GLsizei width_, const GLsizei height_);
+
+	/*
+	Called before drawing a frame, binds the offscreen framebuffer (or the default one).
+	*/
+	void bindFramebuffer() noexcept;
+
+	/*
+	Called after drawing the state of the given iteration, queues the readback of the first frame drawn
+	at or past every multiple of the interval. Files are numbered by that iteration.
+	*/
+	void captureFrame(const std::uint64_t iteration) noexcept;
+
+	/*
+	True after the requested number of frames was captured.
+	*/
+	bool isFinished() const noexcept;
+
+	/*
+	Writes frames still in the pixel buffers, stops the writer and deletes GL objects.
+	*/
+	void cleanup();
+};
+
+#endif
\ No newline at end of file
@@ -4,6 +4,9 @@
 #include "Constants.hpp"
 #include <glm/vec2.hpp>
 
+#include <algorithm>
+#include <cstdint>
+#include <span>
 #include <vector>
 
 class Grid2d
@@ -14,22 +17,79 @@ private:
 	const float xLen;
 	const float yLen;
 
-	using GridCellsT = std::vector<std::vector<std::uint32_t>>;
-	GridCellsT gridCells;
+	/*
+	Compressed (CSR) cell list: particles of cell c are stored contiguously in
+	cellParticles[cellStarts[c], cellStarts[c + 1]).
+	*/
+	std::vector<std::uint32_t> cellStarts;
+	std::vector<std::uint32_t> cellParticles;
+	std::vector<std::uint32_t> particleCells;
+	std::vector<std::uint32_t> cellCursors;
 
 public:
-	Grid2d(const std::uint32_t xMax, const std::uint32_t yMax) noexcept : 
-		xCellsCount((xMax) / (2 * CIRCLE_RADIUS)), yCellsCount((yMax) / (2 * CIRCLE_RADIUS)),
+	class GridCellsView
+	{
+	private:
+		const std::uint32_t* starts;
+		const std::uint32_t* particles;
+		const std::uint32_t* cells;
+		std::uint32_t cellsCount;
+
+	public:
+		GridCellsView(const std::uint32_t* starts_, const std::uint32_t* particles_, const std::uint32_t* cells_, const std::uint32_t cellsCount_) noexcept :
+			starts(starts_), particles(particles_), cells(cells_), cellsCount(cellsCount_) {}
+
+		std::span<const std::uint32_t> operator[](const std::uint32_t cellId) const noexcept
+		{
+			return { particles + starts[cellId], particles + starts[cellId + 1] };
+		}
+
+		/*
+		Particles of consecutive cells [firstCellId, endCellId), cells are stored one after another.
+		*/
+		std::span<const std::uint32_t> getCells(const std::uint32_t firstCellId, const std::uint32_t endCellId) const noexcept
+		{
+			return { particles + starts[firstCellId], particles + starts[endCellId] };
+		}
+
+		/*
+		Position of the first particle of the cell in the cell list.
+		*/
+		std::uint32_t getStart(const std::uint32_t cellId) const noexcept
+		{
+			return starts[cellId];
+		}
+
+		/*
+		Cell the particle was binned into.
+		*/
+		std::uint32_t getCellId(const std::uint32_t particle) const noexcept
+		{
+			return cells[particle];
+		}
+
+		std::uint32_t size() const noexcept
+		{
+			return cellsCount;
+		}
+	};
+
+	Grid2d(const std::uint32_t xMax, const std::uint32_t yMax, const float radius) noexcept : 
+		xCellsCount(std::max(1u, static_cast<std::uint32_t>(xMax / (2.f * radius)))), yCellsCount(std::max(1u, static_cast<std::uint32_t>(yMax / (2.f * radius)))),
 		xLen(static_cast<float>(xMax) / static_cast<float>(xCellsCount)),
 		yLen(static_cast<float>(yMax) / static_cast<float>(yCellsCount)){}
 
-	void initializeGrid();
+	void initializeGrid(const std::uint32_t particlesCount);
+	std::uint32_t getCellId(const glm::vec2 position) const noexcept;
+	std::uint32_t getMortonKey(const glm::vec2 position) const noexcept;
+	float getMeanIndexGap() const noexcept;
 	void addParticleToGridCell(const std::uint32_t i, const glm::vec2 position) noexcept;
+	void buildGridCells() noexcept;
 	void clearGridCells() noexcept;
 
-	const GridCellsT& getGridCells()
+	GridCellsView getGridCells() const noexcept
 	{
-		return gridCells;
+		return { cellStarts.data(), cellParticles.data(), particleCells.data(), xCellsCount * yCellsCount };
 	}
 
 	const std::uint32_t getXCellsCount()
@@ -41,5 +101,15 @@ public:
 	{
 		return yCellsCount;
 	}
+
+	float getXLen() const noexcept
+	{
+		return xLen;
+	}
+
+	float getYLen() const noexcept
+	{
+		return yLen;
+	}
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,231 @@
+#include "Simulation.hpp"
+#include "Config.hpp"
+#include "NarrowPhase.hpp"
+#include "PhaseTimings.hpp"
+#include "Profiler.hpp"
+#include "Trajectory.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+	void printStateSummary(const std::uint32_t step, const StateSummary& summary)
+	{
+		std::cout << "step " << step << " checksum " << std::hex << std::setw(16) << std::setfill('0') << summary.checksum << std::dec
+			<< " energy " << std::setprecision(17) << summary.kineticEnergy << " momentum " << summary.momentum.x << " " << summary.momentum.y
+			<< std::setprecision(6) << "\n";
+	}
+
+	void printPhaseTimings(const std::uint32_t step, const PhaseTimings& timings, const PhysicsEngineType engineType)
+	{
+		for (std::uint32_t i = 0; i < PHYSICS_PHASES_COUNT; ++i)
+		{
+			const Phase phase = static_cast<Phase>(i);
+			if (!isEnginePhase(engineType, phase))
+			{
+				continue;
+			}
+			std::cout << "step " << step << " phase \"" << getPhaseName(phase) << "\" p50 " << timings.getPercentile(phase, 50.f)
+				<< " p95 " << timings.getPercentile(phase, 95.f) << " p99 " << timings.getPercentile(phase, 99.f) << " ms\n";
+		}
+	}
+
+	/*
+	Decodes frames of a trajectory written by a run with the same options one by one and compares each of them
+	with the state when this run reaches its iteration. Per axis errors have to stay within the quantization bound
+	of the reader, plus rounding of decoded coordinates to float.
+	*/
+	class TrajectoryVerifier
+	{
+	private:
+		TrajectoryReader reader;
+		std::string path;
+		std::uint64_t frameIndex = 0;
+		std::uint64_t frameIteration = 0;
+		std::vector<glm::vec2> framePositions;
+		glm::vec2 maxError = glm::vec2(0.f);
+		bool failed = false;
+
+		void readFrame()
+		{
+			if (frameIndex < reader.getFramesCount() && !reader.readFrame(frameIndex, frameIteration, framePositions))
+			{
+				std::cout << "Can't decode frame " << frameIndex << " of trajectory " << path << "\n";
+				failed = true;
+			}
+		}
+
+	public:
+		bool open(const std::string& path_, const std::uint32_t particlesCount)
+		{
+			path = path_;
+			if (!reader.open(path))
+			{
+				return false;
+			}
+			if (reader.getHeader().particlesCount != particlesCount)
+			{
+				std::cout << "Trajectory " << path << " holds " << reader.getHeader().particlesCount << " particles, not " << particlesCount << "\n";
+				return false;
+			}
+			readFrame();
+			return !failed;
+		}
+
+		template<typename PosArrType>
+		void verify(const std::uint64_t iteration, const PosArrType& positions, const std::vector<std::uint32_t>& particleIds)
+		{
+			if (failed || frameIndex == reader.getFramesCount() || iteration < frameIteration)
+			{
+				return;
+			}
+			if (iteration > frameIteration)
+			{
+				std::cout << "Frame " << frameIndex << " of trajectory " << path << " is at iteration " << frameIteration << ", which this run skipped\n";
+				failed = true;
+				return;
+			}
+
+			for (std::uint32_t i = 0; i < positions.size(); ++i)
+			{
+				const glm::vec2 error = framePositions[particleIds[i]] - static_cast<glm::vec2>(positions[i]);
+				maxError.x = std::max(maxError.x, std::abs(error.x));
+				maxError.y = std::max(maxError.y, std::abs(error.y));
+			}
+			++frameIndex;
+			readFrame();
+		}
+
+		bool finish() const
+		{
+			const TrajectoryHeader& header = reader.getHeader();
+			const glm::vec2 bound = reader.getQuantizationErrorBound();
+			const glm::vec2 tolerance = bound + std::numeric_limits<float>::epsilon() * glm::vec2(header.xMax, header.yMax);
+			std::cout << "Verified " << frameIndex << " of " << reader.getFramesCount() << " frames of trajectory " << path << ", max error "
+				<< maxError.x << " " << maxError.y << ", quantization bound " << bound.x << " " << bound.y << "\n";
+			if (failed || frameIndex != reader.getFramesCount() || maxError.x > tolerance.x || maxError.y > tolerance.y)
+			{
+				std::cout << "Trajectory verification failed\n";
+				return false;
+			}
+			return true;
+		}
+	};
+}
+
+/*
+Runs the simulation without a window for --steps iterations as fast as possible,
+accepts the same options as the windowed executable. With --checksum K a summary of the state
+is printed every K steps, runs with the same --seed can be compared line by line. With --timings K
+percentiles of physics phase times over the last PhaseTimings::HISTORY_SIZE steps are printed every K steps,
+--profile path writes a Chrome trace of the last recorded zones at exit. --restore path starts from a checkpoint
+and --checkpoint path saves the final state. --trajectory path streams compressed positions every --trajectory-interval steps,
+--verify-trajectory path runs again with the same options and checks the decoded frames against the simulated state.
+*/
+int main(int argc, char** argv)
+{
+	const std::optional<Config> config = parseConfig(argc, argv);
+	if (!config)
+	{
+		return 1;
+	}
+	std::cout << "Narrow phase kernel: " << getNarrowPhaseKernelName(detectNarrowPhaseKernel()) << "\n";
+
+	Simulation simulation(config->world);
+	if (config->restorePath.empty())
+	{
+		simulation.generateStartValues(config->seed, config->velocityDistribution, config->temperature);
+	}
+	else if (!simulation.loadCheckpoint(config->restorePath))
+	{
+		return 1;
+	}
+	std::cout << "Particles: " << simulation.getParticlesCount() << ", steps: " << config->stepsCount << ", seed: " << simulation.getSeed() << "\n";
+	if (config->checksumInterval != 0)
+	{
+		printStateSummary(0, simulation.getStateSummary());
+	}
+
+	std::unique_ptr<TrajectoryWriter> trajectoryWriter;
+	if (!config->trajectoryPath.empty())
+	{
+		trajectoryWriter = std::make_unique<TrajectoryWriter>(config->trajectoryPath, simulation.getParticlesCount(), config->world.xMax, config->world.yMax,
+			config->trajectoryBits);
+		if (!trajectoryWriter->isOpen())
+		{
+			return 1;
+		}
+	}
+	const auto writeTrajectoryFrame = [&]()
+	{
+		if (trajectoryWriter && simulation.getIterationsCount() % config->trajectoryInterval == 0)
+		{
+			trajectoryWriter->addFrame(simulation.getIterationsCount(), simulation.getPositions(), simulation.getParticleIds());
+		}
+	};
+	writeTrajectoryFrame();
+
+	std::unique_ptr<TrajectoryVerifier> trajectoryVerifier;
+	if (!config->verifyTrajectoryPath.empty())
+	{
+		trajectoryVerifier = std::make_unique<TrajectoryVerifier>();
+		if (!trajectoryVerifier->open(config->verifyTrajectoryPath, simulation.getParticlesCount()))
+		{
+			return 1;
+		}
+		trajectoryVerifier->verify(simulation.getIterationsCount(), simulation.getPositions(), simulation.getParticleIds());
+	}
+
+	setProfilerEnabled(!config->profilePath.empty());
+	PhaseTimings phaseTimings;
+	const auto start = std::chrono::steady_clock::now();
+	for (std::uint32_t step = 1; step <= config->stepsCount; ++step)
+	{
+		simulation.doIteration(config->settings);
+		writeTrajectoryFrame();
+		if (trajectoryVerifier)
+		{
+			trajectoryVerifier->verify(simulation.getIterationsCount(), simulation.getPositions(), simulation.getParticleIds());
+		}
+		phaseTimings.addFrame(simulation.getSimulationStats().phaseDurations);
+		if (config->timingsInterval != 0 && step % config->timingsInterval == 0)
+		{
+			printPhaseTimings(step, phaseTimings, config->settings.engineType);
+		}
+		if (config->checksumInterval != 0 && step % config->checksumInterval == 0)
+		{
+			printStateSummary(step, simulation.getStateSummary());
+		}
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	const double stepsPerSecond = config->stepsCount / elapsed.count();
+	std::cout << "Elapsed " << elapsed.count() << " s, " << stepsPerSecond << " steps/s, "
+		<< stepsPerSecond * simulation.getParticlesCount() << " particle updates/s\n";
+
+	if (trajectoryWriter && !trajectoryWriter->close())
+	{
+		return 1;
+	}
+	if (trajectoryVerifier && !trajectoryVerifier->finish())
+	{
+		return 1;
+	}
+	if (!config->checkpointPath.empty() && !simulation.saveCheckpoint(config->checkpointPath))
+	{
+		return 1;
+	}
+	if (!config->profilePath.empty() && !writeChromeTrace(config->profilePath))
+	{
+		return 1;
+	}
+	return 0;
+}
\ No newline at end of file
@@ -6,32 +6,63 @@
 #include <imgui_impl_opengl3.h>
 #include <implot.h>
 
+#include "SimulationSettings.hpp"
+#include "ParticleArrays.hpp"
+#include "PhaseTimings.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
+/*
+Checkpoint buttons are handled by the physics thread of World between iterations.
+*/
+enum class CheckpointRequest : std::uint8_t
+{
+	None,
+	Save,
+	Load
+};
+
 template<typename VelArrType>
 class ImGuiHandler
 {
 	private:
-		const VelArrType& velocities;
+		const float radius;
 		std::vector<float> xComponent;
 		std::vector<float> yComponent;
 		std::vector<float> speed;
 
 		bool showHistograms = false;
+		bool showTimings = false;
 		bool pause = false;
+		SimulationSettings settings;
+		RenderSettings renderSettings;
+		SimulationStats stats;
+		PhaseTimings phaseTimings;
+		std::vector<float> timingFrames;
+		std::vector<float> stackedTimings;
+		std::array<char, 256> tracePath{ "trace.json" };
+		std::array<char, 256> checkpointPath{ "checkpoint.bin" };
+		CheckpointRequest checkpointRequest = CheckpointRequest::None;
 
-		void velocitiesHistograms() noexcept
+		void velocitiesHistograms(const VelArrType& velocities) noexcept
 		{
 			if (!showHistograms)
 			{
 				return;
 			}
 
+			copyComponents(velocities, xComponent.data(), yComponent.data());
 			for (std::uint32_t i = 0; i < velocities.size(); ++i)
 			{
-				xComponent[i] = velocities[i].x;
-				yComponent[i] = velocities[i].y;
-				speed[i] = glm::length(velocities[i]);
+				speed[i] = sqrtf(xComponent[i] * xComponent[i] + yComponent[i] * yComponent[i]);
 			}
 
 			static int componentsBins = 30;
@@ -59,10 +90,180 @@ class ImGuiHandler
 			ImGui::End();
 		}
 
+		/*
+		Physics phases of the inactive engine are always 0 and hidden.
+		*/
+		bool isPhaseShown(const Phase phase) const noexcept
+		{
+			return static_cast<std::uint32_t>(phase) >= PHYSICS_PHASES_COUNT || isEnginePhase(settings.engineType, phase);
+		}
+
+		/*
+		Percentiles of every phase over the rolling window and a stacked plot of the window,
+		the top of the stack is the whole measured frame time.
+		*/
+		void phaseTimingsWindow() noexcept
+		{
+			if (!showTimings)
+			{
+				return;
+			}
+
+			ImGui::SetNextWindowSize(ImVec2(550, 600), ImGuiCond_Appearing);
+			ImGui::Begin("Phase timings", &showTimings);
+			if (ImGui::BeginTable("##PhasePercentiles", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+			{
+				ImGui::TableSetupColumn("Phase");
+				ImGui::TableSetupColumn("p50 ms");
+				ImGui::TableSetupColumn("p95 ms");
+				ImGui::TableSetupColumn("p99 ms");
+				ImGui::TableHeadersRow();
+				for (std::uint32_t i = 0; i < PHASES_COUNT; ++i)
+				{
+					const Phase phase = static_cast<Phase>(i);
+					if (!isPhaseShown(phase))
+					{
+						continue;
+					}
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn();
+					ImGui::TextUnformatted(getPhaseName(phase));
+					ImGui::TableNextColumn();
+					ImGui::Text("%.3f", phaseTimings.getPercentile(phase, 50.f));
+					ImGui::TableNextColumn();
+					ImGui::Text("%.3f", phaseTimings.getPercentile(phase, 95.f));
+					ImGui::TableNextColumn();
+					ImGui::Text("%.3f", phaseTimings.getPercentile(phase, 99.f));
+				}
+				ImGui::EndTable();
+			}
+
+			const std::uint32_t framesCount = phaseTimings.getFramesCount();
+			for (std::uint32_t frame = 0; frame < framesCount; ++frame)
+			{
+				timingFrames[frame] = static_cast<float>(frame);
+				float stackTop = 0.f;
+				for (std::uint32_t i = 0; i < PHASES_COUNT; ++i)
+				{
+					stackTop += phaseTimings.getDuration(static_cast<Phase>(i), frame);
+					stackedTimings[(i + 1) * PhaseTimings::HISTORY_SIZE + frame] = stackTop;
+				}
+			}
+			if (ImPlot::BeginPlot("##PhaseTimingsPlot", ImVec2(-1, -1)))
+			{
+				ImPlot::SetupAxes("frame", "ms", ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
+				for (std::uint32_t i = 0; i < PHASES_COUNT; ++i)
+				{
+					if (!isPhaseShown(static_cast<Phase>(i)))
+					{
+						continue;
+					}
+					ImPlot::PlotShaded(getPhaseName(static_cast<Phase>(i)), timingFrames.data(), stackedTimings.data() + i * PhaseTimings::HISTORY_SIZE,
+						stackedTimings.data() + (i + 1) * PhaseTimings::HISTORY_SIZE, static_cast<int>(framesCount));
+				}
+				ImPlot::EndPlot();
+			}
+			ImGui::End();
+		}
+
+		void showPhysicsSettings() noexcept
+		{
+			int engineType = static_cast<int>(settings.engineType);
+			if (ImGui::Combo("Physics engine", &engineType, "Fixed substeps\0Event driven\0"))
+			{
+				settings.engineType = static_cast<PhysicsEngineType>(engineType);
+				phaseTimings.clear();
+			}
+
+			ImGui::BeginDisabled(settings.engineType != PhysicsEngineType::TimeStepping);
+			/*
+			Neighbor list collisions are resolved serially, the thread count only applies to grid cells.
+			*/
+			ImGui::BeginDisabled(settings.useNeighborLists);
+			int threadsCount = static_cast<int>(settings.threadsCount);
+			if (ImGui::SliderInt("Physics threads", &threadsCount, 1, static_cast<int>(std::max(1u, std::thread::hardware_concurrency()))))
+			{
+				settings.threadsCount = static_cast<std::uint32_t>(threadsCount);
+			}
+			ImGui::EndDisabled();
+
+			int subStepsCount = static_cast<int>(settings.subStepsCount);
+			if (ImGui::SliderInt("Substeps", &subStepsCount, 1, 20))
+			{
+				settings.subStepsCount = static_cast<std::uint32_t>(subStepsCount);
+			}
+
+			ImGui::Checkbox("Verlet neighbor lists", &settings.useNeighborLists);
+			ImGui::BeginDisabled(!settings.useNeighborLists);
+			ImGui::SliderFloat("Neighbor list skin", &settings.neighborListSkin, 0.1f, 4.f * radius);
+			if (stats.neighborListRebuilds > 0)
+			{
+				ImGui::Text("Neighbor lists rebuilt every %.2f substeps (%llu rebuilds)", static_cast<double>(stats.neighborListSubSteps) / stats.neighborListRebuilds,
+					static_cast<unsigned long long>(stats.neighborListRebuilds));
+			}
+			ImGui::EndDisabled();
+
+			int reorderInterval = static_cast<int>(settings.reorderInterval);
+			if (ImGui::SliderInt("Z-order reorder interval", &reorderInterval, 0, 1000))
+			{
+				settings.reorderInterval = static_cast<std::uint32_t>(reorderInterval);
+			}
+			if (stats.reordersCount > 0)
+			{
+				ImGui::Text("Mean index gap %.1f -> %.1f after %llu reorders", stats.indexGapBeforeReorder, stats.indexGapAfterReorder,
+					static_cast<unsigned long long>(stats.reordersCount));
+			}
+			ImGui::EndDisabled();
+		}
+
+		void showRenderSettings() noexcept
+		{
+			int coloring = static_cast<int>(renderSettings.coloring);
+			if (ImGui::Combo("Particle color", &coloring, "Uniform\0Speed\0"))
+			{
+				renderSettings.coloring = static_cast<ParticleColoring>(coloring);
+			}
+			ImGui::BeginDisabled(renderSettings.coloring != ParticleColoring::Speed);
+			ImGui::DragFloatRange2("Speed range", &renderSettings.minSpeed, &renderSettings.maxSpeed, 0.1f, 0.f, 10.f * vxMax);
+			ImGui::EndDisabled();
+			ImGui::SliderFloat("Density field above particles/pixel", &renderSettings.densityFieldRatio, 0.f, 100.f, "%.3f", ImGuiSliderFlags_Logarithmic);
+			ImGui::TextDisabled("Density field shows density, or thermal speed when colored by speed");
+		}
+
+		void showProfilerSettings() noexcept
+		{
+			bool recordZones = isProfilerEnabled();
+			if (ImGui::Checkbox("Record profiler zones", &recordZones))
+			{
+				setProfilerEnabled(recordZones);
+			}
+			ImGui::InputText("Trace file", tracePath.data(), tracePath.size());
+			ImGui::SameLine();
+			if (ImGui::Button("Write Chrome trace"))
+			{
+				writeChromeTrace(tracePath.data());
+			}
+		}
+
+		void showCheckpointSettings() noexcept
+		{
+			ImGui::InputText("Checkpoint file", checkpointPath.data(), checkpointPath.size());
+			if (ImGui::Button("Save checkpoint"))
+			{
+				checkpointRequest = CheckpointRequest::Save;
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Load checkpoint"))
+			{
+				checkpointRequest = CheckpointRequest::Load;
+			}
+		}
+
 		void showControlPanel() noexcept
 		{
 			ImGui::Begin("Control panel");
 			ImGui::Checkbox("Show velocity statistics", &showHistograms);
+			ImGui::Checkbox("Show phase timings", &showTimings);
 			ImGui::BeginDisabled(pause);
 			if (ImGui::Button("Pause simulation"))
 			{
@@ -76,16 +277,23 @@ class ImGuiHandler
 				pause = false;
 			}
 			ImGui::EndDisabled();
-			ImGui::Text("Simulation average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+			showPhysicsSettings();
+			showRenderSettings();
+			showProfilerSettings();
+			showCheckpointSettings();
+			ImGui::Text("Rendering average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 			ImGui::End();
 		}
 
 	public:
-		ImGuiHandler(const VelArrType& velocities_) : velocities(velocities_)
+		ImGuiHandler(const std::uint32_t particlesCount, const float radius_, const SimulationSettings& settings_, const RenderSettings& renderSettings_) :
+			radius(radius_), settings(settings_), renderSettings(renderSettings_)
 		{
-			xComponent.reserve(velocities.size());
-			yComponent.reserve(velocities.size());
-			speed.reserve(velocities.size());
+			xComponent.resize(particlesCount);
+			yComponent.resize(particlesCount);
+			speed.resize(particlesCount);
+			timingFrames.resize(PhaseTimings::HISTORY_SIZE);
+			stackedTimings.resize((PHASES_COUNT + 1) * PhaseTimings::HISTORY_SIZE);
 		}
 
 		bool pauseSimulation() noexcept
@@ -93,6 +301,46 @@ class ImGuiHandler
 			return pause;
 		}
 
+		const SimulationSettings& getSimulationSettings() const noexcept
+		{
+			return settings;
+		}
+
+		const RenderSettings& getRenderSettings() const noexcept
+		{
+			return renderSettings;
+		}
+
+		CheckpointRequest takeCheckpointRequest() noexcept
+		{
+			return std::exchange(checkpointRequest, CheckpointRequest::None);
+		}
+
+		std::string getCheckpointPath() const
+		{
+			return checkpointPath.data();
+		}
+
+		void setSimulationStats(const SimulationStats& stats_) noexcept
+		{
+			stats = stats_;
+		}
+
+		/*
+		Rendering durations are merged with physics durations of the latest published iteration, physics durations
+		are consumed so that frames rendered without a new iteration (paused or slower physics) don't repeat them.
+		*/
+		void addFrameDurations(const PhaseDurations& renderDurations) noexcept
+		{
+			PhaseDurations durations = renderDurations;
+			for (std::uint32_t i = 0; i < PHYSICS_PHASES_COUNT; ++i)
+			{
+				durations.ms[i] = stats.phaseDurations.ms[i];
+			}
+			phaseTimings.addFrame(durations);
+			stats.phaseDurations = {};
+		}
+
 		bool initialize(GLFWwindow* window) noexcept
 		{
 			ImGui::CreateContext();
@@ -107,14 +355,16 @@ class ImGuiHandler
 			return true;
 		}
 
-		void render() noexcept
+		void render(const VelArrType& velocities) noexcept
 		{
+			PROFILE_ZONE("ImGui render");
 			ImGui_ImplOpenGL3_NewFrame();
 			ImGui_ImplGlfw_NewFrame();
 			ImGui::NewFrame();
 
 			showControlPanel();
-			velocitiesHistograms();
+			velocitiesHistograms(velocities);
+			phaseTimingsWindow();
 
 			ImGui::Render();
 			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
@@ -0,0 +1,61 @@
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+void* mapFileRegion(const std::string& path, const std::uint64_t offset, const std::size_t bytes) noexcept
+{
+	/*
+	The mapping keeps the file open with this share mode, others may rename or delete it meanwhile.
+	*/
+	const HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return nullptr;
+	}
+
+	/*
+	The view keeps the mapping object and the file open, so both handles can be closed right away.
+	*/
+	const HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (mapping == nullptr)
+	{
+		return nullptr;
+	}
+	void* data = MapViewOfFile(mapping, FILE_MAP_COPY, static_cast<DWORD>(offset >> 32), static_cast<DWORD>(offset & 0xFFFFFFFFu), bytes);
+	CloseHandle(mapping);
+	return data;
+}
+
+void unmapFileRegion(void* data, const std::size_t) noexcept
+{
+	UnmapViewOfFile(data);
+}
+#else
+void* mapFileRegion(const std::string& path, const std::uint64_t offset, const std::size_t bytes) noexcept
+{
+	const int file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		return nullptr;
+	}
+
+	void* data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, static_cast<off_t>(offset));
+	close(file);
+	return data == MAP_FAILED ? nullptr : data;
+}
+
+void unmapFileRegion(void* data, const std::size_t bytes) noexcept
+{
+	munmap(data, bytes);
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,22 @@
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+Offsets of mapped regions have to be multiples of the allocation granularity, which is 64 KiB on Windows
+and a page (at most 64 KiB) elsewhere.
+*/
+constexpr std::uint64_t MAPPING_GRANULARITY = 65536;
+
+/*
+Maps bytes of the file starting at offset as private copy-on-write memory (MAP_PRIVATE, FILE_MAP_COPY):
+pages are read from the file on first access and writes never reach the file.
+Returns nullptr when the region can't be mapped.
+*/
+void* mapFileRegion(const std::string& path, const std::uint64_t offset, const std::size_t bytes) noexcept;
+void unmapFileRegion(void* data, const std::size_t bytes) noexcept;
+
+#endif
\ No newline at end of file
@@ -0,0 +1,221 @@
+#include "NarrowPhase.hpp"
+
+#include <algorithm>
+#include <bit>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NARROW_PHASE_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+/*
+MSVC accepts intrinsics of every instruction set in any function, GCC and Clang need them enabled per function.
+*/
+#if defined(_MSC_VER) && !defined(__clang__)
+#define NARROW_PHASE_TARGET(isa)
+#else
+#define NARROW_PHASE_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace
+{
+	/*
+	Hands contacts of a lane mask to onContact in slot order, returns the slot after the first contact that collided,
+	the range is tested again from there with updated coordinates, or 0 when none did.
+	*/
+	std::uint32_t handleContacts(std::uint32_t mask, const std::uint32_t base, const std::uint32_t slot, const ContactCallback onContact, void* context) noexcept
+	{
+		while (mask)
+		{
+			const std::uint32_t contact = base + static_cast<std::uint32_t>(std::countr_zero(mask));
+			if (onContact(context, slot, contact))
+			{
+				return contact + 1;
+			}
+			mask &= mask - 1;
+		}
+		return 0;
+	}
+
+	void resolveRowScalar(const NarrowPhaseRanges& ranges, const ContactCallback onContact, void* context) noexcept
+	{
+		for (std::uint32_t slot = 0; slot < ranges.resolvedCount; ++slot)
+		{
+			for (std::uint32_t range = 0; range < NarrowPhaseRanges::RANGES_PER_SLOT; ++range)
+			{
+				const std::uint32_t end = ranges.getEnd(slot, range);
+				for (std::uint32_t k = ranges.getBegin(slot, range); k < end; ++k)
+				{
+					const float dx = ranges.xs[k] - ranges.xs[slot];
+					const float dy = ranges.ys[k] - ranges.ys[slot];
+					if (dx * dx + dy * dy < ranges.distanceSquared)
+					{
+						onContact(context, slot, k);
+					}
+				}
+			}
+		}
+	}
+
+#ifdef NARROW_PHASE_X86
+	/*
+	Lanes of a vector of the given width starting at k that are still inside the range, none for an empty range.
+	*/
+	std::uint32_t getActiveLanes(const std::uint32_t k, const std::uint32_t end, const std::uint32_t width) noexcept
+	{
+		return (1u << std::min(end - k, width)) - 1;
+	}
+
+	/*
+	Every range is tested at least once, a whole vector of lanes covers almost all of them, so the loop doesn't branch
+	on the candidates count. Coordinates of the slot are broadcast in every iteration, they change when a contact collides
+	and nothing has to be kept in vector registers across the callback.
+	*/
+	NARROW_PHASE_TARGET("sse4.2")
+	void resolveRowSSE42(const NarrowPhaseRanges& ranges, const ContactCallback onContact, void* context) noexcept
+	{
+		for (std::uint32_t slot = 0; slot < ranges.resolvedCount; ++slot)
+		{
+			for (std::uint32_t range = 0; range < NarrowPhaseRanges::RANGES_PER_SLOT; ++range)
+			{
+				const std::uint32_t end = ranges.getEnd(slot, range);
+				std::uint32_t k = ranges.getBegin(slot, range);
+				do
+				{
+					const __m128 dx = _mm_sub_ps(_mm_loadu_ps(ranges.xs + k), _mm_set1_ps(ranges.xs[slot]));
+					const __m128 dy = _mm_sub_ps(_mm_loadu_ps(ranges.ys + k), _mm_set1_ps(ranges.ys[slot]));
+					const __m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+					const std::uint32_t mask = static_cast<std::uint32_t>(_mm_movemask_ps(_mm_cmplt_ps(d2, _mm_set1_ps(ranges.distanceSquared)))) & getActiveLanes(k, end, 4);
+					if (const std::uint32_t restart = mask ? handleContacts(mask, k, slot, onContact, context) : 0; restart != 0)
+					{
+						k = restart;
+						continue;
+					}
+					k += 4;
+				} while (k < end);
+			}
+		}
+	}
+
+	NARROW_PHASE_TARGET("avx2")
+	void resolveRowAVX2(const NarrowPhaseRanges& ranges, const ContactCallback onContact, void* context) noexcept
+	{
+		for (std::uint32_t slot = 0; slot < ranges.resolvedCount; ++slot)
+		{
+			for (std::uint32_t range = 0; range < NarrowPhaseRanges::RANGES_PER_SLOT; ++range)
+			{
+				const std::uint32_t end = ranges.getEnd(slot, range);
+				std::uint32_t k = ranges.getBegin(slot, range);
+				do
+				{
+					const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(ranges.xs + k), _mm256_set1_ps(ranges.xs[slot]));
+					const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(ranges.ys + k), _mm256_set1_ps(ranges.ys[slot]));
+					const __m256 d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+					const std::uint32_t mask = static_cast<std::uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(d2, _mm256_set1_ps(ranges.distanceSquared), _CMP_LT_OQ))) & getActiveLanes(k, end, 8);
+					if (const std::uint32_t restart = mask ? handleContacts(mask, k, slot, onContact, context) : 0; restart != 0)
+					{
+						k = restart;
+						continue;
+					}
+					k += 8;
+				} while (k < end);
+			}
+		}
+	}
+
+	void cpuid(const std::uint32_t leaf, std::uint32_t (&registers)[4]) noexcept
+	{
+#if defined(_MSC_VER)
+		int values[4];
+		__cpuidex(values, static_cast<int>(leaf), 0);
+		for (int i = 0; i < 4; ++i)
+		{
+			registers[i] = static_cast<std::uint32_t>(values[i]);
+		}
+#else
+		__cpuid_count(leaf, 0, registers[0], registers[1], registers[2], registers[3]);
+#endif
+	}
+
+	std::uint64_t getEnabledStates() noexcept
+	{
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		std::uint32_t eax, edx;
+		__asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return (static_cast<std::uint64_t>(edx) << 32) | eax;
+#endif
+	}
+#endif
+}
+
+NarrowPhaseKernel detectNarrowPhaseKernel() noexcept
+{
+#ifdef NARROW_PHASE_X86
+	std::uint32_t registers[4] = {};
+	cpuid(0, registers);
+	const std::uint32_t maxLeaf = registers[0];
+
+	cpuid(1, registers);
+	const bool sse42 = registers[2] & (1u << 20);
+	const bool osxsave = registers[2] & (1u << 27);
+	const bool avx = registers[2] & (1u << 28);
+
+	/*
+	Wide registers are usable only when the OS saves them on context switch (XCR0).
+	*/
+	const std::uint64_t enabledStates = osxsave ? getEnabledStates() : 0;
+	const bool avxStates = (enabledStates & 0x6) == 0x6;
+
+	bool avx2 = false;
+	if (maxLeaf >= 7)
+	{
+		cpuid(7, registers);
+		avx2 = registers[1] & (1u << 5);
+	}
+
+	if (avx && avx2 && avxStates)
+	{
+		return NarrowPhaseKernel::AVX2;
+	}
+	if (sse42)
+	{
+		return NarrowPhaseKernel::SSE42;
+	}
+#endif
+	return NarrowPhaseKernel::Scalar;
+}
+
+NarrowPhaseRowKernel getNarrowPhaseRowKernel(const NarrowPhaseKernel kernel) noexcept
+{
+	switch (kernel)
+	{
+#ifdef NARROW_PHASE_X86
+	case NarrowPhaseKernel::SSE42:
+		return &resolveRowSSE42;
+	case NarrowPhaseKernel::AVX2:
+		return &resolveRowAVX2;
+#endif
+	default:
+		return &resolveRowScalar;
+	}
+}
+
+const char* getNarrowPhaseKernelName(const NarrowPhaseKernel kernel) noexcept
+{
+	switch (kernel)
+	{
+	case NarrowPhaseKernel::SSE42:
+		return "SSE4.2";
+	case NarrowPhaseKernel::AVX2:
+		return "AVX2";
+	default:
+		return "scalar";
+	}
+}
\ No newline at end of file
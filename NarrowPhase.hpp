@@ -0,0 +1,161 @@
+#ifndef NARROWPHASE_HPP
+#define NARROWPHASE_HPP
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+enum class NarrowPhaseKernel : std::uint8_t
+{
+	Scalar,
+	SSE42,
+	AVX2
+};
+
+/*
+Slots of a NarrowPhaseBlock as read by the kernels. The particle in slot s < resolvedCount is tested against
+slots (s, nearEnds[s]) and then [farBegins[s], farEnds[s]), so that every pair is visited once and in stencil order.
+*/
+struct NarrowPhaseRanges
+{
+	const float* xs;
+	const float* ys;
+	const std::uint32_t* nearEnds;
+	const std::uint32_t* farBegins;
+	const std::uint32_t* farEnds;
+	std::uint32_t resolvedCount;
+	float distanceSquared;
+
+	static constexpr std::uint32_t RANGES_PER_SLOT = 2;
+
+	std::uint32_t getBegin(const std::uint32_t slot, const std::uint32_t range) const noexcept
+	{
+		return range == 0 ? slot + 1 : farBegins[slot];
+	}
+
+	std::uint32_t getEnd(const std::uint32_t slot, const std::uint32_t range) const noexcept
+	{
+		return range == 0 ? nearEnds[slot] : farEnds[slot];
+	}
+};
+
+/*
+Called for a candidate closer than the tested distance, returns true when the pair collided. Both particles
+were then moved and their coordinates in the block updated, the rest of the range is tested again after contact.
+*/
+using ContactCallback = bool(*)(void* context, const std::uint32_t slot, const std::uint32_t contact) noexcept;
+
+/*
+Tests every resolved slot against its ranges in vector lanes with squared distances, set bits of the lane mask
+are compacted into contacts handed to onContact in slot order. Kernels read whole vector lanes and ignore lanes
+past the end of a range, xs/ys have to be readable NARROW_PHASE_PADDING slots past the last range.
+*/
+using NarrowPhaseRowKernel = void(*)(const NarrowPhaseRanges& ranges, const ContactCallback onContact, void* context) noexcept;
+
+inline constexpr std::uint32_t NARROW_PHASE_PADDING = 8;
+
+NarrowPhaseKernel detectNarrowPhaseKernel() noexcept;
+NarrowPhaseRowKernel getNarrowPhaseRowKernel(const NarrowPhaseKernel kernel) noexcept;
+const char* getNarrowPhaseKernelName(const NarrowPhaseKernel kernel) noexcept;
+
+/*
+Cells of one cell's half stencil, the resolved cell first.
+*/
+struct NarrowPhaseStencil
+{
+	static constexpr std::uint32_t MAX_CELLS_COUNT = 5;
+
+	std::array<std::span<const std::uint32_t>, MAX_CELLS_COUNT> cells;
+	std::uint32_t cellsCount = 0;
+
+	void push(const std::span<const std::uint32_t> cell) noexcept
+	{
+		cells[cellsCount++] = cell;
+	}
+};
+
+/*
+Particles of a run of consecutive cells gathered into contiguous x/y arrays in cell list order,
+with the candidate ranges of every resolved slot.
+*/
+class NarrowPhaseBlock
+{
+private:
+	std::vector<std::uint32_t> indices;
+	std::vector<float> xs;
+	std::vector<float> ys;
+	std::vector<std::uint32_t> nearEnds;
+	std::vector<std::uint32_t> farBegins;
+	std::vector<std::uint32_t> farEnds;
+	std::uint32_t count = 0;
+
+	void reserve(const std::uint32_t requiredCount)
+	{
+		if (requiredCount + NARROW_PHASE_PADDING > xs.size())
+		{
+			const std::size_t newSize = 2 * (requiredCount + NARROW_PHASE_PADDING);
+			indices.resize(newSize);
+			xs.resize(newSize);
+			ys.resize(newSize);
+			nearEnds.resize(newSize);
+			farBegins.resize(newSize);
+			farEnds.resize(newSize);
+		}
+	}
+
+public:
+	void clear() noexcept
+	{
+		count = 0;
+	}
+
+	template<typename PosArrType>
+	void append(const std::span<const std::uint32_t> cells, const PosArrType& positions)
+	{
+		reserve(count + static_cast<std::uint32_t>(cells.size()));
+		for (const std::uint32_t i : cells)
+		{
+			indices[count] = i;
+			xs[count] = positions[i].x;
+			ys[count] = positions[i].y;
+			++count;
+		}
+	}
+
+	void setRanges(const std::uint32_t slot, const std::uint32_t nearEnd, const std::uint32_t farBegin, const std::uint32_t farEnd) noexcept
+	{
+		nearEnds[slot] = nearEnd;
+		farBegins[slot] = farBegin;
+		farEnds[slot] = farEnd;
+	}
+
+	/*
+	Runs the kernel over slots [0, resolvedCount), which need their ranges set.
+	*/
+	void resolve(const NarrowPhaseRowKernel kernel, const std::uint32_t resolvedCount, const float distanceSquared,
+		const ContactCallback onContact, void* context) const noexcept
+	{
+		const NarrowPhaseRanges ranges{ xs.data(), ys.data(), nearEnds.data(), farBegins.data(), farEnds.data(), resolvedCount, distanceSquared };
+		kernel(ranges, onContact, context);
+	}
+
+	template<typename PosArrType>
+	void update(const std::uint32_t slot, const PosArrType& positions) noexcept
+	{
+		xs[slot] = positions[indices[slot]].x;
+		ys[slot] = positions[indices[slot]].y;
+	}
+
+	std::uint32_t getCount() const noexcept
+	{
+		return count;
+	}
+
+	std::uint32_t getIndex(const std::uint32_t slot) const noexcept
+	{
+		return indices[slot];
+	}
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,129 @@
+#include "OffscreenContext.hpp"
+
+#include <iostream>
+
+#if defined(__linux__)
+#define OFFSCREEN_CONTEXT_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <cstring>
+#endif
+
+#ifdef OFFSCREEN_CONTEXT_EGL
+namespace
+{
+	bool hasExtension(const char* extensions, const char* name) noexcept
+	{
+		const std::size_t length = std::strlen(name);
+		for (const char* found = extensions ? std::strstr(extensions, name) : nullptr; found != nullptr; found = std::strstr(found + length, name))
+		{
+			if ((found == extensions || found[-1] == ' ') && (found[length] == ' ' || found[length] == '\0'))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/*
+	Surfaceless platform first, it needs no device access, the first device otherwise.
+	*/
+	EGLDisplay getPlatformDisplay() noexcept
+	{
+		const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+		const auto getPlatformDisplayEXT = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+		if (getPlatformDisplayEXT == nullptr)
+		{
+			return EGL_NO_DISPLAY;
+		}
+
+		if (hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless"))
+		{
+			if (EGLDisplay display = getPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr); display != EGL_NO_DISPLAY)
+			{
+				return display;
+			}
+		}
+
+		const auto queryDevicesEXT = reinterpret_cast<PFNEGLQUERYDEVICESEXTPROC>(eglGetProcAddress("eglQueryDevicesEXT"));
+		EGLDeviceEXT device;
+		EGLint devicesCount = 0;
+		if (hasExtension(clientExtensions, "EGL_EXT_platform_device") && queryDevicesEXT != nullptr && queryDevicesEXT(1, &device, &devicesCount) && devicesCount > 0)
+		{
+			return getPlatformDisplayEXT(EGL_PLATFORM_DEVICE_EXT, device, nullptr);
+		}
+		return EGL_NO_DISPLAY;
+	}
+}
+#endif
+
+OffscreenContext::~OffscreenContext()
+{
+	destroy();
+}
+
+bool OffscreenContext::create()
+{
+#ifdef OFFSCREEN_CONTEXT_EGL
+	display = getPlatformDisplay();
+	EGLint major = 0, minor = 0;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+	{
+		std::cout << "No EGL display without a window system (needs EGL_MESA_platform_surfaceless or EGL_EXT_platform_device)\n";
+		display = nullptr;
+		return false;
+	}
+	if (!hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context") || !eglBindAPI(EGL_OPENGL_API))
+	{
+		std::cout << "EGL display doesn't support surfaceless OpenGL contexts\n";
+		destroy();
+		return false;
+	}
+
+	/*
+	Surface type 0 matches configs of any surface type, none is ever created.
+	*/
+	constexpr EGLint configAttributes[] = { EGL_SURFACE_TYPE, 0, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	constexpr EGLint contextAttributes[] = { EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE };
+	EGLConfig config;
+	EGLint configsCount = 0;
+	if (!eglChooseConfig(display, configAttributes, &config, 1, &configsCount) || configsCount == 0)
+	{
+		std::cout << "No EGL config for OpenGL\n";
+		destroy();
+		return false;
+	}
+	context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+	{
+		std::cout << "Creating an OpenGL 3.3 core context failed, EGL error 0x" << std::hex << eglGetError() << std::dec << "\n";
+		destroy();
+		return false;
+	}
+	std::cout << "Surfaceless EGL " << major << "." << minor << " context on " << eglQueryString(display, EGL_VENDOR) << "\n";
+	return true;
+#else
+	std::cout << "Surfaceless contexts need EGL, which isn't available on this platform\n";
+	return false;
+#endif
+}
+
+void OffscreenContext::destroy() noexcept
+{
+#ifdef OFFSCREEN_CONTEXT_EGL
+	if (display == nullptr)
+	{
+		return;
+	}
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (context != nullptr)
+	{
+		eglDestroyContext(display, context);
+		context = nullptr;
+	}
+	eglTerminate(display);
+	display = nullptr;
+#endif
+}
\ No newline at end of file
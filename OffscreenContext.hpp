@@ -0,0 +1,30 @@
+#ifndef OFFSCREENCONTEXT_HPP
+#define OFFSCREENCONTEXT_HPP
+
+/*
+OpenGL 3.3 core context without a window or a display server, created directly through EGL: on the surfaceless
+platform (EGL_MESA_platform_surfaceless, Mesa drivers and llvmpipe) or else on the first EGL device
+(EGL_EXT_platform_device, e.g. NVIDIA without X). There is no default framebuffer, everything is drawn into
+framebuffer objects. EGL is only linked on Linux, elsewhere create() fails.
+*/
+class OffscreenContext
+{
+private:
+	void* display = nullptr;
+	void* context = nullptr;
+
+public:
+	OffscreenContext() = default;
+	~OffscreenContext();
+
+	OffscreenContext(const OffscreenContext&) = delete;
+	OffscreenContext& operator=(const OffscreenContext&) = delete;
+
+	/*
+	Creates the context and makes it current on the calling thread.
+	*/
+	bool create();
+	void destroy() noexcept;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,389 @@
+#ifndef PARTICLEARRAYS_HPP
+#define PARTICLEARRAYS_HPP
+
+#include "MappedFile.hpp"
+
+#include <glm/vec2.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+#include <string>
+
+/*
+Heap array of count values aligned to a cache line, sized once at construction.
+Can also own a copy-on-write mapping of a file region, which is page aligned.
+*/
+template<typename T>
+class AlignedBuffer
+{
+private:
+	static constexpr std::size_t ALIGNMENT = 64;
+
+	struct Deleter
+	{
+		std::size_t mappedBytes = 0;
+
+		void operator()(T* values) const noexcept
+		{
+			if (mappedBytes != 0)
+			{
+				unmapFileRegion(values, mappedBytes);
+				return;
+			}
+			::operator delete[](values, std::align_val_t(ALIGNMENT));
+		}
+	};
+
+	std::unique_ptr<T[], Deleter> values;
+	std::size_t count = 0;
+
+	AlignedBuffer(T* mappedValues, const std::size_t count_) noexcept : values(mappedValues, Deleter{ count_ * sizeof(T) }), count(count_)
+	{
+	}
+
+public:
+	explicit AlignedBuffer(const std::size_t count_) :
+		values(static_cast<T*>(::operator new[](count_ * sizeof(T), std::align_val_t(ALIGNMENT)))), count(count_)
+	{
+		std::uninitialized_value_construct_n(values.get(), count);
+	}
+
+	/*
+	Uses count values stored in the file at offset as the array contents without reading them,
+	for trivially copyable types only.
+	*/
+	static std::optional<AlignedBuffer> mapFile(const std::string& path, const std::uint64_t offset, const std::size_t count_) noexcept
+	{
+		void* mappedValues = mapFileRegion(path, offset, count_ * sizeof(T));
+		if (mappedValues == nullptr)
+		{
+			return std::nullopt;
+		}
+		return AlignedBuffer(static_cast<T*>(mappedValues), count_);
+	}
+
+	/*
+	Replaces a file mapping by an owned copy of the values, so the file can be replaced or deleted.
+	*/
+	void detachFromFile()
+	{
+		if (values.get_deleter().mappedBytes != 0)
+		{
+			AlignedBuffer copy(count);
+			std::copy_n(values.get(), count, copy.data());
+			*this = std::move(copy);
+		}
+	}
+
+	T& operator[](const std::size_t i) noexcept
+	{
+		return values[i];
+	}
+
+	const T& operator[](const std::size_t i) const noexcept
+	{
+		return values[i];
+	}
+
+	std::size_t size() const noexcept
+	{
+		return count;
+	}
+
+	T* data() noexcept
+	{
+		return values.get();
+	}
+
+	const T* data() const noexcept
+	{
+		return values.get();
+	}
+
+	/*
+	Calls f with every AlignedBuffer storing the array, whole arrays are saved and mapped this way.
+	*/
+	template<typename F>
+	void forEachBuffer(F&& f)
+	{
+		f(*this);
+	}
+
+	template<typename F>
+	void forEachBuffer(F&& f) const
+	{
+		f(*this);
+	}
+};
+
+/*
+Mutable view of one element of Vec2ArraySoA. Converts to glm::vec2 and supports the vector
+operations used by the engine, so code written against glm::vec2& works on both layouts.
+Copying a Vec2Ref copies the reference, not the value - use glm::vec2 for temporaries.
+*/
+class Vec2Ref
+{
+public:
+	float& x;
+	float& y;
+
+	Vec2Ref(float& x_, float& y_) noexcept : x(x_), y(y_) {}
+
+	operator glm::vec2() const noexcept
+	{
+		return { x, y };
+	}
+
+	Vec2Ref& operator=(const glm::vec2 value) noexcept
+	{
+		x = value.x;
+		y = value.y;
+		return *this;
+	}
+
+	Vec2Ref& operator=(const Vec2Ref& other) noexcept
+	{
+		return *this = glm::vec2(other);
+	}
+
+	Vec2Ref& operator+=(const glm::vec2 value) noexcept
+	{
+		x += value.x;
+		y += value.y;
+		return *this;
+	}
+
+	Vec2Ref& operator-=(const glm::vec2 value) noexcept
+	{
+		x -= value.x;
+		y -= value.y;
+		return *this;
+	}
+
+	friend glm::vec2 operator-(const Vec2Ref a) noexcept
+	{
+		return -glm::vec2(a);
+	}
+
+	friend glm::vec2 operator+(const Vec2Ref a, const Vec2Ref b) noexcept
+	{
+		return glm::vec2(a) + glm::vec2(b);
+	}
+
+	friend glm::vec2 operator+(const Vec2Ref a, const glm::vec2 b) noexcept
+	{
+		return glm::vec2(a) + b;
+	}
+
+	friend glm::vec2 operator+(const glm::vec2 a, const Vec2Ref b) noexcept
+	{
+		return a + glm::vec2(b);
+	}
+
+	friend glm::vec2 operator-(const Vec2Ref a, const Vec2Ref b) noexcept
+	{
+		return glm::vec2(a) - glm::vec2(b);
+	}
+
+	friend glm::vec2 operator-(const Vec2Ref a, const glm::vec2 b) noexcept
+	{
+		return glm::vec2(a) - b;
+	}
+
+	friend glm::vec2 operator-(const glm::vec2 a, const Vec2Ref b) noexcept
+	{
+		return a - glm::vec2(b);
+	}
+
+	friend glm::vec2 operator*(const float a, const Vec2Ref b) noexcept
+	{
+		return a * glm::vec2(b);
+	}
+
+	friend glm::vec2 operator*(const Vec2Ref a, const float b) noexcept
+	{
+		return glm::vec2(a) * b;
+	}
+};
+
+/*
+Structure of arrays storage of 2d vectors: all x components followed by all y components,
+each in its own cache line aligned array.
+*/
+class Vec2ArraySoA
+{
+private:
+	AlignedBuffer<float> xs;
+	AlignedBuffer<float> ys;
+
+public:
+	explicit Vec2ArraySoA(const std::size_t count) : xs(count), ys(count) {}
+
+	Vec2Ref operator[](const std::size_t i) noexcept
+	{
+		return { xs[i], ys[i] };
+	}
+
+	glm::vec2 operator[](const std::size_t i) const noexcept
+	{
+		return { xs[i], ys[i] };
+	}
+
+	std::size_t size() const noexcept
+	{
+		return xs.size();
+	}
+
+	float* xData() noexcept
+	{
+		return xs.data();
+	}
+
+	float* yData() noexcept
+	{
+		return ys.data();
+	}
+
+	const float* xData() const noexcept
+	{
+		return xs.data();
+	}
+
+	const float* yData() const noexcept
+	{
+		return ys.data();
+	}
+
+	template<typename F>
+	void forEachBuffer(F&& f)
+	{
+		f(xs);
+		f(ys);
+	}
+
+	template<typename F>
+	void forEachBuffer(F&& f) const
+	{
+		f(xs);
+		f(ys);
+	}
+};
+
+/*
+Layout policies select the container used by World for positions and velocities.
+*/
+struct AosLayout
+{
+	using Vec2Array = AlignedBuffer<glm::vec2>;
+	static constexpr std::uint32_t LAYOUT_ID = 0;
+};
+
+struct SoaLayout
+{
+	using Vec2Array = Vec2ArraySoA;
+	static constexpr std::uint32_t LAYOUT_ID = 1;
+};
+
+/*
+Bulk operations over whole arrays, SoA overloads work on plain float arrays so compilers can vectorize them.
+*/
+template<typename PosArrType, typename VelArrType>
+void integratePositions(PosArrType& positions, const VelArrType& velocities, const float deltaT) noexcept
+{
+	for (std::size_t i = 0; i < positions.size(); ++i)
+	{
+		positions[i] += deltaT * velocities[i];
+	}
+}
+
+inline void integratePositions(Vec2ArraySoA& positions, const Vec2ArraySoA& velocities, const float deltaT) noexcept
+{
+	const std::size_t count = positions.size();
+	float* x = positions.xData();
+	float* y = positions.yData();
+	const float* vx = velocities.xData();
+	const float* vy = velocities.yData();
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		x[i] += deltaT * vx[i];
+	}
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		y[i] += deltaT * vy[i];
+	}
+}
+
+/*
+One axis of wall reflections, a and va are the components along the axis, b and vb the other ones.
+Particles past a wall are moved back by deltaT and then forward with the reflected velocity from the time they touched it.
+Written with selects instead of branches so that compilers vectorize it, lanes without a collision are left as they were.
+Comparisons are the quiet ones, ordinary ones may raise on NaN and are kept behind branches under strict floating point.
+*/
+inline void reflectFromWalls(float* a, float* b, float* va, const float* vb, const std::size_t count, const float minA, const float maxA,
+	const float deltaT) noexcept
+{
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		const float ai = a[i];
+		const float bi = b[i];
+		const float vai = va[i];
+		const float vbi = vb[i];
+		const bool hitsMin = std::islessequal(ai, minA);
+		const bool hits = hitsMin | std::isgreaterequal(ai, maxA);
+		const float wall = hitsMin ? minA : maxA;
+		const float deltaTReflection = deltaT - (wall - (ai - deltaT * vai)) / vai;
+		a[i] = hits ? wall - deltaTReflection * vai : ai;
+		b[i] = hits ? bi - deltaT * vbi + deltaTReflection * vbi : bi;
+		va[i] = hits ? -vai : vai;
+	}
+}
+
+/*
+Walls of all particles, x walls first like the per particle checks of the physics engine.
+*/
+inline void reflectFromWalls(Vec2ArraySoA& positions, Vec2ArraySoA& velocities, const float radius, const float xMax, const float yMax,
+	const float deltaT) noexcept
+{
+	const std::size_t count = positions.size();
+	reflectFromWalls(positions.xData(), positions.yData(), velocities.xData(), velocities.yData(), count, radius, xMax - radius, deltaT);
+	reflectFromWalls(positions.yData(), positions.xData(), velocities.yData(), velocities.xData(), count, radius, yMax - radius, deltaT);
+}
+
+template<typename VelArrType>
+void copyComponents(const VelArrType& vectors, float* xComponent, float* yComponent) noexcept
+{
+	for (std::size_t i = 0; i < vectors.size(); ++i)
+	{
+		xComponent[i] = vectors[i].x;
+		yComponent[i] = vectors[i].y;
+	}
+}
+
+inline void copyComponents(const Vec2ArraySoA& vectors, float* xComponent, float* yComponent) noexcept
+{
+	std::copy(vectors.xData(), vectors.xData() + vectors.size(), xComponent);
+	std::copy(vectors.yData(), vectors.yData() + vectors.size(), yComponent);
+}
+
+
+template<typename ArrType>
+void copyVectors(const ArrType& source, ArrType& destination) noexcept
+{
+	for (std::size_t i = 0; i < source.size(); ++i)
+	{
+		destination[i] = source[i];
+	}
+}
+
+inline void copyVectors(const Vec2ArraySoA& source, Vec2ArraySoA& destination) noexcept
+{
+	std::copy(source.xData(), source.xData() + source.size(), destination.xData());
+	std::copy(source.yData(), source.yData() + source.size(), destination.yData());
+}
+
+#endif
\ No newline at end of file
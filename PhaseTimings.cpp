@@ -0,0 +1,75 @@
+#include "PhaseTimings.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+const char* getPhaseName(const Phase phase) noexcept
+{
+	switch (phase)
+	{
+	case Phase::GridClear:
+		return "Grid clear";
+	case Phase::IntegrateAndBin:
+		return "Integrate and bin";
+	case Phase::InteriorCells:
+		return "Interior cells";
+	case Phase::BoundaryCells:
+		return "Boundary cells";
+	case Phase::Events:
+		return "Events";
+	case Phase::EventSync:
+		return "Event sync";
+	case Phase::BufferUpload:
+		return "Buffer upload";
+	case Phase::ImGuiRender:
+		return "ImGui render";
+	case Phase::SwapBuffers:
+		return "Swap buffers";
+	default:
+		return "Unknown";
+	}
+}
+
+void PhaseTimings::addFrame(const PhaseDurations& durations) noexcept
+{
+	for (std::uint32_t i = 0; i < PHASES_COUNT; ++i)
+	{
+		history[i][nextFrame] = durations.ms[i];
+	}
+	nextFrame = (nextFrame + 1) % HISTORY_SIZE;
+	framesCount = std::min(framesCount + 1, HISTORY_SIZE);
+}
+
+void PhaseTimings::clear() noexcept
+{
+	framesCount = 0;
+	nextFrame = 0;
+}
+
+float PhaseTimings::getPercentile(const Phase phase, const float percentile) const noexcept
+{
+	if (framesCount == 0)
+	{
+		return 0.f;
+	}
+
+	std::array<float, HISTORY_SIZE> sorted;
+	const auto& values = history[static_cast<std::uint32_t>(phase)];
+	std::copy(values.begin(), values.begin() + framesCount, sorted.begin());
+
+	const float rank = std::ceil(percentile / 100.f * framesCount);
+	const std::uint32_t index = static_cast<std::uint32_t>(std::clamp(rank, 1.f, static_cast<float>(framesCount))) - 1;
+	std::nth_element(sorted.begin(), sorted.begin() + index, sorted.begin() + framesCount);
+	return sorted[index];
+}
+
+float PhaseTimings::getDuration(const Phase phase, const std::uint32_t frame) const noexcept
+{
+	const std::uint32_t oldestFrame = framesCount < HISTORY_SIZE ? 0 : nextFrame;
+	return history[static_cast<std::uint32_t>(phase)][(oldestFrame + frame) % HISTORY_SIZE];
+}
+
+std::uint32_t PhaseTimings::getFramesCount() const noexcept
+{
+	return framesCount;
+}
\ No newline at end of file
@@ -0,0 +1,103 @@
+#ifndef PHASETIMINGS_HPP
+#define PHASETIMINGS_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+/*
+Timed parts of a frame, physics phases (summed over substeps) come first, followed by rendering phases.
+Grid phases are timed by the time stepping engine, event phases by the event driven one.
+*/
+enum class Phase : std::uint8_t
+{
+	GridClear,
+	IntegrateAndBin,
+	InteriorCells,
+	BoundaryCells,
+	Events,
+	EventSync,
+	BufferUpload,
+	ImGuiRender,
+	SwapBuffers,
+	Count
+};
+
+constexpr std::uint32_t PHASES_COUNT = static_cast<std::uint32_t>(Phase::Count);
+constexpr std::uint32_t PHYSICS_PHASES_COUNT = static_cast<std::uint32_t>(Phase::BufferUpload);
+
+const char* getPhaseName(const Phase phase) noexcept;
+
+/*
+Milliseconds spent in every phase during one frame.
+*/
+struct PhaseDurations
+{
+	std::array<float, PHASES_COUNT> ms{};
+
+	float& operator[](const Phase phase) noexcept
+	{
+		return ms[static_cast<std::uint32_t>(phase)];
+	}
+
+	float operator[](const Phase phase) const noexcept
+	{
+		return ms[static_cast<std::uint32_t>(phase)];
+	}
+};
+
+/*
+Adds the time between construction and destruction to the duration of the given phase.
+*/
+class ScopedTimer
+{
+private:
+	using Clock = std::chrono::steady_clock;
+
+	float& durationMs;
+	const Clock::time_point start;
+
+public:
+	ScopedTimer(PhaseDurations& durations, const Phase phase) noexcept : durationMs(durations[phase]), start(Clock::now())
+	{
+	}
+
+	~ScopedTimer()
+	{
+		durationMs += std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+	}
+
+	ScopedTimer(const ScopedTimer&) = delete;
+	ScopedTimer& operator=(const ScopedTimer&) = delete;
+};
+
+/*
+Rolling window of durations of the last HISTORY_SIZE frames, used for percentiles and time series plots.
+*/
+class PhaseTimings
+{
+public:
+	static constexpr std::uint32_t HISTORY_SIZE = 600;
+
+private:
+	std::array<std::array<float, HISTORY_SIZE>, PHASES_COUNT> history{};
+	std::uint32_t framesCount = 0;
+	std::uint32_t nextFrame = 0;
+
+public:
+	void addFrame(const PhaseDurations& durations) noexcept;
+	void clear() noexcept;
+
+	/*
+	Nearest rank percentile (0-100) of the phase durations in the window.
+	*/
+	float getPercentile(const Phase phase, const float percentile) const noexcept;
+
+	/*
+	Frames are indexed from the oldest (0) to the newest (getFramesCount() - 1).
+	*/
+	float getDuration(const Phase phase, const std::uint32_t frame) const noexcept;
+	std::uint32_t getFramesCount() const noexcept;
+};
+
+#endif
\ No newline at end of file
@@ -3,6 +3,12 @@
 
 #include "Constants.hpp"
 #include "Grid.hpp"
+#include "ThreadPool.hpp"
+#include "SimulationSettings.hpp"
+#include "NarrowPhase.hpp"
+#include "ParticleArrays.hpp"
+#include "PhaseTimings.hpp"
+#include "Profiler.hpp"
 
 #include <glm/vec2.hpp>
 #include <glm/geometric.hpp>
@@ -11,7 +17,14 @@
 #include <cmath>
 #include <random>
 #include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <numbers>
+#include <span>
+#include <type_traits>
+#include <vector>
 
 template<typename PosArrType, typename VelArrType>
 class Physics
@@ -23,61 +36,99 @@ private:
 	const std::uint32_t xMax;
 	const std::uint32_t yMax;
 
+	/*
+	All particles share one radius, derived lengths are computed once.
+	*/
+	const float radius;
+	const float diameter;
+	const float diameterSquared;
+
 	Grid2d grid;
+	std::unique_ptr<ThreadPool> threadPool;
+	NarrowPhaseKernel narrowPhaseKernel;
+	NarrowPhaseRowKernel rowKernel;
+
+	/*
+	Verlet neighbor lists: for every particle i, neighbors[neighborStarts[i], neighborStarts[i + 1]) holds
+	particles j > i closer than diameter + neighborListSkin when lists were built.
+	Lists stay valid until some particle moves more than half of the skin from its referencePosition.
+	*/
+	bool useNeighborLists = false;
+	float neighborListSkin = radius;
+	std::vector<std::uint32_t> neighborStarts;
+	std::vector<std::uint32_t> neighbors;
+	std::vector<glm::vec2> referencePositions;
+
+	/*
+	Particles are periodically sorted along the Z-order curve of grid cells, so that particles close in space
+	are close in memory. particleIds[slot] is the stable id of the particle currently stored at slot, everything that
+	outlives a reorder refers to particles by it: state checksums, checkpoints and trajectory frames.
+	Reordering happens at multiples of iterationsCount, which initialize() resets together with the ids, so a new state
+	starts a new schedule and a restored run keeps its schedule through setIterationsCount.
+	*/
+	std::uint32_t reorderInterval = 0;
+	std::uint64_t iterationsCount = 0;
+	std::vector<std::uint32_t> particleIds;
+	std::vector<std::uint64_t> reorderKeys;
+	std::vector<glm::vec2> reorderBuffer;
+	std::vector<std::uint32_t> reorderIdsBuffer;
+
+	std::uint32_t subStepsCount = 5;
+	SimulationStats stats;
 
 	void checkXCollisions(const std::uint32_t i, const float deltaSubStep) noexcept
 	{
-		if (positions[i].x <= CIRCLE_RADIUS)
+		if (positions[i].x <= radius)
 		{
 			positions[i] -= deltaSubStep * velocities[i];
 
-			float deltaSubStepTBoundary = (CIRCLE_RADIUS - positions[i].x) / velocities[i].x;
+			float deltaSubStepTBoundary = (radius - positions[i].x) / velocities[i].x;
 			float deltaSubStepTReflection = deltaSubStep - deltaSubStepTBoundary;
 
 			velocities[i].x = -velocities[i].x;
-			positions[i].x = CIRCLE_RADIUS;
+			positions[i].x = radius;
 			positions[i] += deltaSubStepTReflection * velocities[i];
 		}
-		else if (positions[i].x >= xMax - CIRCLE_RADIUS)
+		else if (positions[i].x >= xMax - radius)
 		{
 			positions[i] -= deltaSubStep * velocities[i];
 
-			float deltaSubStepTBoundary = (xMax - CIRCLE_RADIUS - positions[i].x) / velocities[i].x;
+			float deltaSubStepTBoundary = (xMax - radius - positions[i].x) / velocities[i].x;
 			float deltaSubStepTReflection = deltaSubStep - deltaSubStepTBoundary;
 
 			velocities[i].x = -velocities[i].x;
-			positions[i].x = static_cast<float>(xMax - CIRCLE_RADIUS);
+			positions[i].x = xMax - radius;
 			positions[i] += deltaSubStepTReflection * velocities[i];
 		}
 	}
 
 	void checkYCollisions(const std::uint32_t i, const float deltaSubStep) noexcept
 	{
-		if (positions[i].y <= CIRCLE_RADIUS)
+		if (positions[i].y <= radius)
 		{
 			positions[i] -= deltaSubStep * velocities[i];
 
-			float deltaSubStepTBoundary = (CIRCLE_RADIUS - positions[i].y) / velocities[i].y;
+			float deltaSubStepTBoundary = (radius - positions[i].y) / velocities[i].y;
 			float deltaSubStepTReflection = deltaSubStep - deltaSubStepTBoundary;
 
 			velocities[i].y = -velocities[i].y;
-			positions[i].y = CIRCLE_RADIUS;
+			positions[i].y = radius;
 			positions[i] += deltaSubStepTReflection * velocities[i];
 		}
-		else if (positions[i].y >= yMax - CIRCLE_RADIUS)
+		else if (positions[i].y >= yMax - radius)
 		{
 			positions[i] -= deltaSubStep * velocities[i];
 
-			float deltaSubStepTBoundary = (yMax - CIRCLE_RADIUS - positions[i].y) / velocities[i].y;
+			float deltaSubStepTBoundary = (yMax - radius - positions[i].y) / velocities[i].y;
 			float deltaSubStepTReflection = deltaSubStep - deltaSubStepTBoundary;
 
 			velocities[i].y = -velocities[i].y;
-			positions[i].y = static_cast<float>(yMax - CIRCLE_RADIUS);
+			positions[i].y = yMax - radius;
 			positions[i] += deltaSubStepTReflection * velocities[i];
 		}
 	}
 
-	void resolveWallsCollisions(auto& cellParticles, const float deltaSubStep) noexcept
+	void resolveWallsCollisions(const std::span<const std::uint32_t> cellParticles, const float deltaSubStep) noexcept
 	{
 		for (std::uint32_t i = 0; i < cellParticles.size(); ++i)
 		{
@@ -86,7 +137,7 @@ private:
 		}
 	}
 
-	void resolveHorizontalWallCollisions(auto& cellParticles, const float deltaSubStep) noexcept
+	void resolveHorizontalWallCollisions(const std::span<const std::uint32_t> cellParticles, const float deltaSubStep) noexcept
 	{
 		for (std::uint32_t i = 0; i < cellParticles.size(); ++i)
 		{
@@ -94,7 +145,7 @@ private:
 		}
 	}
 
-	void resolveVerticalWallCollisions(auto& cellParticles, const float deltaSubStep) noexcept
+	void resolveVerticalWallCollisions(const std::span<const std::uint32_t> cellParticles, const float deltaSubStep) noexcept
 	{
 		for (std::uint32_t i = 0; i < cellParticles.size(); ++i)
 		{
@@ -102,279 +153,771 @@ private:
 		}
 	}
 
-	void resolveBoundaryCells(const auto& gridCells, const std::uint32_t columns, std::uint32_t rows, const float deltaSubStep) noexcept
+	/*
+	Half stencil of a boundary cell, neighbours outside of the grid are skipped.
+	*/
+	std::uint32_t resolveBoundaryCell(const Grid2d::GridCellsView gridCells, const std::uint32_t columns, const std::uint32_t rows, const std::uint32_t x, const std::uint32_t y, const float deltaSubStep) noexcept
+	{
+		const std::uint32_t currentCellId = y * columns + x;
+		if (gridCells[currentCellId].empty())
+		{
+			return 0;
+		}
+
+		NarrowPhaseStencil stencil;
+		stencil.push(gridCells[currentCellId]);
+		if (x + 1 < columns)
+		{
+			stencil.push(gridCells[currentCellId + 1]);
+		}
+		if (y + 1 < rows)
+		{
+			if (x > 0)
+			{
+				stencil.push(gridCells[currentCellId + (columns - 1)]);
+			}
+			stencil.push(gridCells[currentCellId + columns]);
+			if (x + 1 < columns)
+			{
+				stencil.push(gridCells[currentCellId + (columns + 1)]);
+			}
+		}
+		return resolveStencilCollisions(stencil, deltaSubStep);
+	}
+
+	std::uint32_t resolveBoundaryCells(const Grid2d::GridCellsView gridCells, const std::uint32_t columns, std::uint32_t rows, const float deltaSubStep) noexcept
 	{
+		std::uint32_t collisionsCount = 0;
+
 		//bottom left corner
-		resolveCellCollisions(gridCells[0], gridCells[0], deltaSubStep);
+		collisionsCount += resolveBoundaryCell(gridCells, columns, rows, 0, 0, deltaSubStep);
 		resolveWallsCollisions(gridCells[0], deltaSubStep);
 
 		//bottom
 		std::uint32_t i = 1;
 		for (; i < columns - 1; ++i)
 		{
-			resolveCellCollisions(gridCells[i], gridCells[i - 1], deltaSubStep);
-			resolveCellCollisions(gridCells[i], gridCells[i], deltaSubStep);
-			resolveCellCollisions(gridCells[i], gridCells[i + 1], deltaSubStep);
+			collisionsCount += resolveBoundaryCell(gridCells, columns, rows, i, 0, deltaSubStep);
 			resolveHorizontalWallCollisions(gridCells[i], deltaSubStep);
 		}
 
 		//bottom right corner
-		resolveCellCollisions(gridCells[columns - 1], gridCells[columns - 1], deltaSubStep);
+		collisionsCount += resolveBoundaryCell(gridCells, columns, rows, columns - 1, 0, deltaSubStep);
 		resolveWallsCollisions(gridCells[columns - 1], deltaSubStep);
 
 		//left
 		for (++i; i < rows * columns - columns; i += columns)
 		{
-			resolveCellCollisions(gridCells[i], gridCells[i - columns], deltaSubStep);
-			resolveCellCollisions(gridCells[i], gridCells[i], deltaSubStep);
-			resolveCellCollisions(gridCells[i], gridCells[i + columns], deltaSubStep);
+			collisionsCount += resolveBoundaryCell(gridCells, columns, rows, 0, i / columns, deltaSubStep);
 			resolveVerticalWallCollisions(gridCells[i], deltaSubStep);
 		}
 
 		//top left corner
-		resolveCellCollisions(gridCells[i], gridCells[i], deltaSubStep);
+		collisionsCount += resolveBoundaryCell(gridCells, columns, rows, 0, rows - 1, deltaSubStep);
 		resolveWallsCollisions(gridCells[i], deltaSubStep);
 
+		//top
 		for (++i; i < rows * columns - 1; ++i)
 		{
-			resolveCellCollisions(gridCells[i], gridCells[i - 1], deltaSubStep);
-			resolveCellCollisions(gridCells[i], gridCells[i], deltaSubStep);
-			resolveCellCollisions(gridCells[i], gridCells[i + 1], deltaSubStep);
+			collisionsCount += resolveBoundaryCell(gridCells, columns, rows, i % columns, rows - 1, deltaSubStep);
 			resolveHorizontalWallCollisions(gridCells[i], deltaSubStep);
 		}
 
 		//top right corner
-		resolveCellCollisions(gridCells[i], gridCells[i], deltaSubStep);
+		collisionsCount += resolveBoundaryCell(gridCells, columns, rows, columns - 1, rows - 1, deltaSubStep);
 		resolveWallsCollisions(gridCells[i], deltaSubStep);
 
 		//right
 		for (i -= columns; i > columns; i -= columns)
 		{
-			resolveCellCollisions(gridCells[i], gridCells[i - columns], deltaSubStep);
-			resolveCellCollisions(gridCells[i], gridCells[i], deltaSubStep);
-			resolveCellCollisions(gridCells[i], gridCells[i + columns], deltaSubStep);
+			collisionsCount += resolveBoundaryCell(gridCells, columns, rows, columns - 1, i / columns, deltaSubStep);
 			resolveVerticalWallCollisions(gridCells[i], deltaSubStep);
 		}
+		return collisionsCount;
 	}
 
-	float getCollisionTime(const glm::vec2 relativePosition, const glm::vec2 relativePositionPrev, const glm::vec2 relativeVelocity) noexcept
+	/*
+	Time t >= 0 to rewind an overlapping pair so that |r - t * v| = diameter, where r and v are relative
+	position and velocity. Quadratic a * t^2 - 2 * b * t + c = 0 has c < 0 for an overlapping pair, so the
+	discriminant is never negative and the positive root is picked by the sign of b in the form free of cancellation.
+	Returns NaN or infinity only for pairs without relative motion.
+	*/
+	static float getCollisionTime(const glm::vec2 relativePosition, const glm::vec2 relativeVelocity, const float diameterSquared) noexcept
 	{
-		float aLin = (relativePosition.y - relativePositionPrev.y) / (relativePosition.x - relativePositionPrev.x);
-		float bLin = relativePosition.y - aLin * relativePosition.x;
+		const float a = glm::dot(relativeVelocity, relativeVelocity);
+		const float b = glm::dot(relativePosition, relativeVelocity);
+		const float c = glm::dot(relativePosition, relativePosition) - diameterSquared;
+		const float discriminantRoot = sqrtf(b * b - a * c);
 
-		float aQuad = 1.f + aLin * aLin;
-		float deltaQuad = 4.f * (4.f * CIRCLE_RADIUS * CIRCLE_RADIUS * aQuad - bLin * bLin);
+		return b >= 0.f ? (b + discriminantRoot) / a : -c / (discriminantRoot - b);
+	}
 
-		float bQuad = 2.f * aLin * bLin;
-		float x1 = (-bQuad - sqrtf(deltaQuad)) / (2.f * aQuad);
-		float x2 = (-bQuad + sqrtf(deltaQuad)) / (2.f * aQuad);
-		float y1 = aLin * x1 + bLin;
-		float y2 = aLin * x2 + bLin;
+	/*
+	Pushes both particles apart along the line of centers so that they touch, distance is |posI - posJ|.
+	*/
+	void moveAlongsideCenterLine(glm::vec2& posI, glm::vec2& posJ, const float distance) const noexcept
+	{
+		const glm::vec2 normal = distance > 0.f ? (posI - posJ) / distance : glm::vec2(1.f, 0.f);
+		const glm::vec2 correction = (radius - 0.5f * distance) * normal;
+		posI += correction;
+		posJ -= correction;
+	}
 
-		glm::vec2 v1(x1, y1);
-		glm::vec2 v2(x2, y2);
+	void updateNewVelocities(const std::uint32_t i, const std::uint32_t j) noexcept
+	{
+		const glm::vec2 diffPos_ij = positions[i] - positions[j];
+		const glm::vec2 impulse = glm::dot(velocities[i] - velocities[j], diffPos_ij) / glm::dot(diffPos_ij, diffPos_ij) * diffPos_ij;
 
-		float t1 = glm::distance(v1, relativePosition) / glm::length(relativeVelocity);
-		float t2 = glm::distance(v2, relativePosition) / glm::length(relativeVelocity);
+		velocities[i] -= impulse;
+		velocities[j] += impulse;
+	}
 
-		auto pos1 = relativePosition - t1 * relativeVelocity;
-		auto pos2 = relativePosition - t2 * relativeVelocity;
+	void updateAfterCollision(const std::uint32_t i, const std::uint32_t j, const float deltaSubStep, const float distance) noexcept
+	{
+		const float collisionTime = getCollisionTime(positions[i] - positions[j], velocities[i] - velocities[j], diameterSquared);
 
-		constexpr glm::vec2 posJ(0.f, 0.f);
-		if (fabs(glm::distance(pos1, posJ) - 2.f * CIRCLE_RADIUS) < fabs(glm::distance(pos2, posJ) - 2.f * CIRCLE_RADIUS))
+		/*
+		Negated comparison also sends pairs without relative motion (NaN time) to the fallback.
+		*/
+		if (!(collisionTime <= deltaSubStep))
 		{
-			return t1;
+			glm::vec2 posI = positions[i];
+			glm::vec2 posJ = positions[j];
+			moveAlongsideCenterLine(posI, posJ, distance);
+			positions[i] = posI;
+			positions[j] = posJ;
+			updateNewVelocities(i, j);
+			return;
 		}
-		return t2;
+		positions[i] -= collisionTime * velocities[i];
+		positions[j] -= collisionTime * velocities[j];
+		
+		updateNewVelocities(i, j);
+
+		float afterCollisionTime = deltaSubStep - collisionTime;
+		positions[i] += afterCollisionTime * velocities[i];
+		positions[j] += afterCollisionTime * velocities[j];
 	}
 
-	glm::vec2 solveDistQuadratic(const glm::vec2 reference, const float distance) noexcept
+	static NarrowPhaseBlock& getThreadBlock() noexcept
 	{
-		float aLin = reference.y / reference.x;
-		float aQuad = 1.f + aLin * aLin;
-		float cQuad = distance * distance;
-		float x1 = sqrtf(cQuad / aQuad);
+		thread_local NarrowPhaseBlock block;
+		return block;
+	}
 
-		return {x1, aLin * x1};
+	struct BlockContext
+	{
+		Physics& physics;
+		NarrowPhaseBlock& block;
+		const float deltaSubStep;
+		std::uint32_t collisionsCount = 0;
+	};
+
+	/*
+	Contact found by the row kernel, the pair is resolved when the exact distance confirms the overlap.
+	*/
+	static bool resolveBlockContact(void* context, const std::uint32_t slot, const std::uint32_t contact) noexcept
+	{
+		BlockContext& blockContext = *static_cast<BlockContext*>(context);
+		Physics& physics = blockContext.physics;
+		const std::uint32_t i = blockContext.block.getIndex(slot);
+		const std::uint32_t j = blockContext.block.getIndex(contact);
+		if (float d = glm::length(physics.positions[i] - physics.positions[j]); d < physics.diameter)
+		{
+			physics.updateAfterCollision(i, j, blockContext.deltaSubStep, d);
+			blockContext.block.update(slot, physics.positions);
+			blockContext.block.update(contact, physics.positions);
+			++blockContext.collisionsCount;
+			return true;
+		}
+		return false;
 	}
 
-	void moveAlongsideCenterLine(glm::vec2& posI, glm::vec2& posJ, const float penetrationLength) noexcept
+	/*
+	Resolves particles of stencil.cells[0] against the rest of the stencil in place, in stencil order.
+	Used for boundary cells, whose stencils lack some neighbours, with the same squared distance test as the kernels.
+	*/
+	std::uint32_t resolveStencilCollisions(const NarrowPhaseStencil& stencil, const float deltaSubStep) noexcept
 	{
-		float distanceToMove = CIRCLE_RADIUS - penetrationLength / 2.f;
-		glm::vec2 posICorrection = solveDistQuadratic(posJ - posI, distanceToMove);
-		glm::vec2 posJCorrection = solveDistQuadratic(posI - posJ, distanceToMove);
+		const std::span<const std::uint32_t> cell = stencil.cells[0];
+		std::uint32_t collisionsCount = 0;
+		for (std::uint32_t s = 0; s < cell.size(); ++s)
+		{
+			const std::uint32_t i = cell[s];
+			for (std::uint32_t k = 0; k < stencil.cellsCount; ++k)
+			{
+				const std::span<const std::uint32_t> candidates = stencil.cells[k];
+				for (std::uint32_t t = k == 0 ? s + 1 : 0; t < candidates.size(); ++t)
+				{
+					const std::uint32_t j = candidates[t];
+					const glm::vec2 difference = positions[j] - positions[i];
+					if (difference.x * difference.x + difference.y * difference.y >= diameterSquared)
+					{
+						continue;
+					}
+					if (float d = glm::length(positions[i] - positions[j]); d < diameter)
+					{
+						updateAfterCollision(i, j, deltaSubStep, d);
+						++collisionsCount;
+					}
+				}
+			}
+		}
+		return collisionsCount;
+	}
 
-		glm::vec2 tmp = posI;
-		if (glm::distance(posJ, posICorrection + posI) > glm::distance(posJ, posI - posICorrection))
+	/*
+	Resolves interior cells 1..columns-2 of the row. Checking conflicts of an "inside" cell with neighbouring cells, example 4x4:
+											11 12 13 14
+											8  9  10 11
+											4  5  6  7
+											0  1  2  3
+	Every pair of particles is checked once, so only half of the neighbourhood is visited (pairs within the cell
+	itself are taken from the upper triangle), for cell 5 checks for:
+											8 9 10
+											  5 6
+	Lower neighbours check against this cell when they are resolved, boundary cells are handled in resolveBoundaryCells
+	with the same stencil.
+	Cells from row * columns + 1 to (row + 2) * columns - 1 are consecutive in the cell list, they are gathered into one
+	block per row. The half stencil of a particle in cell c is then two ranges of slots: the rest of c together with c + 1,
+	and cells c + columns - 1 to c + columns + 1. Ranges are tested in stencil order, like resolveStencilCollisions does.
+	*/
+	std::uint32_t resolveInteriorRow(const Grid2d::GridCellsView gridCells, const std::uint32_t columns, const std::uint32_t row, const float deltaSubStep) noexcept
+	{
+		PROFILE_ZONE("Interior row");
+		const std::uint32_t firstCellId = row * columns + 1;
+		const std::uint32_t endCellId = firstCellId + columns - 2;
+		const std::uint32_t base = gridCells.getStart(firstCellId);
+		NarrowPhaseBlock& block = getThreadBlock();
+		block.clear();
+		block.append(gridCells.getCells(firstCellId, (row + 2) * columns), positions);
+
+		const std::uint32_t resolvedCount = gridCells.getStart(endCellId) - base;
+		for (std::uint32_t slot = 0; slot < resolvedCount; ++slot)
 		{
-			posI += posICorrection;
+			const std::uint32_t cellId = gridCells.getCellId(block.getIndex(slot));
+			block.setRanges(slot, gridCells.getStart(cellId + 2) - base, gridCells.getStart(cellId + columns - 1) - base,
+				gridCells.getStart(cellId + columns + 2) - base);
 		}
-		else
+
+		BlockContext context{ *this, block, deltaSubStep };
+		block.resolve(rowKernel, resolvedCount, diameterSquared, &resolveBlockContact, &context);
+		return context.collisionsCount;
+	}
+
+	/*
+	Returns the number of resolved pair collisions.
+	*/
+	std::uint64_t resolveCollisions(const float deltaSubStep) noexcept
+	{
+		PROFILE_ZONE("Resolve collisions");
+		const auto gridCells = grid.getGridCells();
+		const std::uint32_t columns = grid.getXCellsCount();
+		const std::uint32_t rows = grid.getYCellsCount();
+
+		/*
+		Resolving a cell touches particles from its row and the row above, so interior rows are
+		split into 2 colors (row % 2). Rows of the same color don't share any particle and are
+		resolved concurrently, colors are processed one after another.
+		Serial resolution follows the same order, so results don't depend on the threads count.
+		*/
+		constexpr std::uint32_t COLORS_COUNT = 2;
+		std::atomic<std::uint64_t> collisionsCount = 0;
 		{
-			posI -= posICorrection;
+			ScopedTimer timer(stats.phaseDurations, Phase::InteriorCells);
+			for (std::uint32_t color = 0; color < COLORS_COUNT; ++color)
+			{
+				const std::uint32_t firstRow = 1 + color;
+				const std::uint32_t rowsCount = firstRow < rows - 1 ? (rows - 2 - firstRow) / COLORS_COUNT + 1 : 0;
+				if (!threadPool)
+				{
+					for (std::uint32_t k = 0; k < rowsCount; ++k)
+					{
+						collisionsCount += resolveInteriorRow(gridCells, columns, firstRow + k * COLORS_COUNT, deltaSubStep);
+					}
+					continue;
+				}
+
+				threadPool->parallelFor(rowsCount, [&](const std::uint32_t k)
+				{
+					collisionsCount.fetch_add(resolveInteriorRow(gridCells, columns, firstRow + k * COLORS_COUNT, deltaSubStep), std::memory_order_relaxed);
+				});
+			}
 		}
 
-		if (glm::distance(tmp, posJCorrection + posJ) > glm::distance(tmp, posJ - posJCorrection))
+		PROFILE_ZONE("Boundary cells");
+		ScopedTimer timer(stats.phaseDurations, Phase::BoundaryCells);
+		collisionsCount += resolveBoundaryCells(gridCells, columns, rows, deltaSubStep);
+		return collisionsCount;
+	}
+
+	void buildNeighborLists() noexcept
+	{
+		rebuildGrid();
+
+		const auto gridCells = grid.getGridCells();
+		const std::int32_t columns = static_cast<std::int32_t>(grid.getXCellsCount());
+		const std::int32_t rows = static_cast<std::int32_t>(grid.getYCellsCount());
+		const float cutoff = diameter + neighborListSkin;
+		const float cutoffSquared = cutoff * cutoff;
+		const std::int32_t range = static_cast<std::int32_t>(ceilf(cutoff / std::min(grid.getXLen(), grid.getYLen())));
+
+		neighborStarts.resize(positions.size() + 1);
+		referencePositions.resize(positions.size());
+		neighbors.clear();
+		for (std::uint32_t i = 0; i < positions.size(); ++i)
 		{
-			posJ += posJCorrection;
+			neighborStarts[i] = static_cast<std::uint32_t>(neighbors.size());
+			referencePositions[i] = positions[i];
+
+			const std::int32_t cellId = static_cast<std::int32_t>(grid.getCellId(positions[i]));
+			const std::int32_t xCell = cellId % columns;
+			const std::int32_t yCell = cellId / columns;
+			for (std::int32_t y = std::max(0, yCell - range); y <= std::min(rows - 1, yCell + range); ++y)
+			{
+				for (std::int32_t x = std::max(0, xCell - range); x <= std::min(columns - 1, xCell + range); ++x)
+				{
+					for (const std::uint32_t j : gridCells[x + y * columns])
+					{
+						const glm::vec2 diff = positions[i] - positions[j];
+						if (j > i && glm::dot(diff, diff) < cutoffSquared)
+						{
+							neighbors.push_back(j);
+						}
+					}
+				}
+			}
 		}
-		else
+		neighborStarts[positions.size()] = static_cast<std::uint32_t>(neighbors.size());
+		++stats.neighborListRebuilds;
+	}
+
+	bool neighborListsExpired() const noexcept
+	{
+		if (neighborStarts.empty())
 		{
-			posJ -= posJCorrection;
+			return true;
 		}
+
+		const float maxDisplacementSquared = 0.25f * neighborListSkin * neighborListSkin;
+		for (std::uint32_t i = 0; i < positions.size(); ++i)
+		{
+			const glm::vec2 displacement = positions[i] - referencePositions[i];
+			if (glm::dot(displacement, displacement) > maxDisplacementSquared)
+			{
+				return true;
+			}
+		}
+		return false;
 	}
 
-	void updateNewVelocities(const std::uint32_t i, const std::uint32_t j) noexcept
+	void updateNeighborLists() noexcept
+	{
+		if (neighborListsExpired())
+		{
+			buildNeighborLists();
+		}
+		++stats.neighborListSubSteps;
+	}
+
+	/*
+	Serial regardless of the thread count, pairs of a list update both particles and lists aren't partitioned
+	into independent groups like rows of grid cells.
+	*/
+	std::uint64_t resolveNeighborListCollisions(const float deltaSubStep) noexcept
 	{
-		auto velocity_i = velocities[i];
-		auto diffPos_ij = positions[i] - positions[j];
-		auto lengthDiffPos_ij = glm::length(positions[i] - positions[j]);
+		std::uint64_t collisionsCount = 0;
+		for (std::uint32_t i = 0; i < positions.size(); ++i)
+		{
+			for (std::uint32_t k = neighborStarts[i]; k < neighborStarts[i + 1]; ++k)
+			{
+				const std::uint32_t j = neighbors[k];
+				if (float d = glm::length(positions[i] - positions[j]); d < diameter)
+				{
+					updateAfterCollision(i, j, deltaSubStep, d);
+					++collisionsCount;
+				}
+			}
+		}
 
-		velocities[i] -= glm::dot((velocities[i] - velocities[j]), diffPos_ij) / (lengthDiffPos_ij * lengthDiffPos_ij) * diffPos_ij;
-		velocities[j] += glm::dot((velocities[j] - velocity_i), -diffPos_ij) / (lengthDiffPos_ij * lengthDiffPos_ij) * diffPos_ij;
+		if constexpr (std::is_same_v<PosArrType, Vec2ArraySoA> && std::is_same_v<VelArrType, Vec2ArraySoA>)
+		{
+			reflectFromWalls(positions, velocities, radius, static_cast<float>(xMax), static_cast<float>(yMax), deltaSubStep);
+		}
+		else
+		{
+			for (std::uint32_t i = 0; i < positions.size(); ++i)
+			{
+				checkXCollisions(i, deltaSubStep);
+				checkYCollisions(i, deltaSubStep);
+			}
+		}
+		return collisionsCount;
 	}
 
-	void updateAfterCollision(const std::uint32_t i, const std::uint32_t j, const float deltaSubStep, const float penetrationLength) noexcept
+	void binParticles() noexcept
 	{
-		auto relativePosition = positions[i] - positions[j];
-		auto relativeVelocity = velocities[i] - velocities[j];
-		auto relativePositionPrev = relativePosition - deltaSubStep * relativeVelocity;
+		for (std::uint32_t i = 0; i < positions.size(); ++i)
+		{
+			grid.addParticleToGridCell(i, positions[i]);
+		}
+		grid.buildGridCells();
+	}
 
-		float collisionTime = getCollisionTime(relativePosition, relativePositionPrev, relativeVelocity);
+	void rebuildGrid() noexcept
+	{
+		grid.clearGridCells();
+		binParticles();
+	}
 
-		if (collisionTime > deltaSubStep)
+	template<typename ArrType, typename ValueType>
+	void permute(ArrType& values, const std::vector<std::uint64_t>& keys, std::vector<ValueType>& buffer) noexcept
+	{
+		for (std::uint32_t k = 0; k < keys.size(); ++k)
 		{
-			moveAlongsideCenterLine(positions[i], positions[j], penetrationLength);
-			updateNewVelocities(i, j);
-			return;
+			buffer[k] = values[static_cast<std::uint32_t>(keys[k])];
 		}
-		positions[i] -= collisionTime * velocities[i];
-		positions[j] -= collisionTime * velocities[j];
-		
-		updateNewVelocities(i, j);
+		for (std::uint32_t k = 0; k < keys.size(); ++k)
+		{
+			values[k] = buffer[k];
+		}
+	}
 
-		float afterCollisionTime = deltaSubStep - collisionTime;
-		positions[i] += afterCollisionTime * velocities[i];
-		positions[j] += afterCollisionTime * velocities[j];
+	/*
+	Sorts all per particle arrays by Morton key of the particle's cell. Neighbor lists refer to old slots
+	and are dropped. Mean index gap of the cell traversal is reported before and after sorting.
+	Particles of a cell are resolved in slot order, so a reorder changes the order of pair updates and the
+	rounding of their results: runs with different intervals are not bit exact, they diverge like any chaotic
+	system perturbed at the last bit, while kinetic energy stays equal up to rounding.
+	*/
+	void reorderParticles()
+	{
+		const std::uint32_t particlesCount = static_cast<std::uint32_t>(positions.size());
+
+		rebuildGrid();
+		stats.indexGapBeforeReorder = grid.getMeanIndexGap();
+
+		reorderKeys.resize(particlesCount);
+		for (std::uint32_t i = 0; i < particlesCount; ++i)
+		{
+			reorderKeys[i] = (static_cast<std::uint64_t>(grid.getMortonKey(positions[i])) << 32) | i;
+		}
+		std::sort(reorderKeys.begin(), reorderKeys.end());
+
+		reorderBuffer.resize(particlesCount);
+		reorderIdsBuffer.resize(particlesCount);
+		permute(positions, reorderKeys, reorderBuffer);
+		permute(velocities, reorderKeys, reorderBuffer);
+		permute(particleIds, reorderKeys, reorderIdsBuffer);
+		neighborStarts.clear();
+
+		rebuildGrid();
+		stats.indexGapAfterReorder = grid.getMeanIndexGap();
+		++stats.reordersCount;
 	}
 
-	void resolveCellCollisions(const auto& cell, const auto& adjacentCell, const float deltaSubStep) noexcept
+	/*
+	Random sequential insertion, candidates are checked only against particles in nearby cells
+	of an occupancy grid. Cells have diameter / sqrt(2) side, so each holds at most one particle
+	(the background grid of Bridson's Poisson-disk sampling) and overlaps are found in a 5x5 block of cells.
+	Cells store positions directly, empty cells hold a point far enough outside the world to never overlap.
+	Returns false when the attempts budget runs out, which happens close to the jamming density of random insertion.
+	*/
+	bool spawnRandomly(std::mt19937& engine) noexcept
 	{
-		for (std::uint32_t i = 0; i < cell.size(); ++i)
+		constexpr std::uint64_t MIN_ATTEMPTS = 1000000;
+		constexpr std::uint64_t ATTEMPTS_PER_PARTICLE = 100;
+
+		const float cellSize = diameter / std::numbers::sqrt2_v<float>;
+		const std::int32_t columns = std::max(1, static_cast<std::int32_t>(ceilf(xMax / cellSize)));
+		const std::int32_t rows = std::max(1, static_cast<std::int32_t>(ceilf(yMax / cellSize)));
+		const glm::vec2 emptyCell(-2.f * diameter);
+		std::vector<glm::vec2> cells(static_cast<std::size_t>(columns) * rows, emptyCell);
+
+		std::uniform_real_distribution<float> posXDistr(radius, xMax - radius);
+		std::uniform_real_distribution<float> posYDistr(radius, yMax - radius);
+
+		const std::uint64_t maxAttempts = std::max(MIN_ATTEMPTS, ATTEMPTS_PER_PARTICLE * positions.size());
+		std::uint32_t placedCount = 0;
+		for (std::uint64_t attempt = 0; attempt < maxAttempts && placedCount < positions.size(); ++attempt)
 		{
-			for (std::uint32_t j = 0; j < adjacentCell.size(); ++j)
+			const glm::vec2 candidate(posXDistr(engine), posYDistr(engine));
+			const std::int32_t xCell = std::min(columns - 1, static_cast<std::int32_t>(candidate.x / cellSize));
+			const std::int32_t yCell = std::min(rows - 1, static_cast<std::int32_t>(candidate.y / cellSize));
+			glm::vec2& cell = cells[static_cast<std::size_t>(yCell) * columns + xCell];
+
+			bool overlaps = cell != emptyCell;
+			for (std::int32_t y = std::max(0, yCell - 2); y <= std::min(rows - 1, yCell + 2) && !overlaps; ++y)
 			{
-				if (cell[i] != adjacentCell[j])
+				for (std::int32_t x = std::max(0, xCell - 2); x <= std::min(columns - 1, xCell + 2); ++x)
 				{
-					if (float d = glm::distance(positions[cell[i]], positions[adjacentCell[j]]); d < 2.f * CIRCLE_RADIUS)
-					{
-						updateAfterCollision(cell[i], adjacentCell[j], deltaSubStep, d);
-					}
+					const glm::vec2 diff = candidate - cells[static_cast<std::size_t>(y) * columns + x];
+					overlaps |= glm::dot(diff, diff) < diameterSquared;
 				}
 			}
+
+			if (!overlaps)
+			{
+				cell = candidate;
+				positions[placedCount++] = candidate;
+			}
 		}
+		return placedCount == positions.size();
 	}
 
-	void resolveCollisions(const float deltaSubStep) noexcept
+	/*
+	Every particle gets its own cell of a lattice covering the world and is jittered inside it without
+	touching the cell borders. Works up to the density of square packing.
+	*/
+	bool spawnOnLattice(std::mt19937& engine) noexcept
 	{
-		const auto& gridCells = grid.getGridCells();
-		const std::uint32_t columns = grid.getXCellsCount();
-		const std::uint32_t rows = grid.getYCellsCount();
+		const std::uint32_t count = static_cast<std::uint32_t>(positions.size());
+		const std::uint32_t maxColumns = static_cast<std::uint32_t>(xMax / diameter);
+		const std::uint32_t columns = std::min(maxColumns, std::max(1u, static_cast<std::uint32_t>(ceilf(sqrtf(static_cast<float>(count) * xMax / yMax)))));
+		if (columns == 0)
+		{
+			return false;
+		}
+		const std::uint32_t rows = (count + columns - 1) / columns;
+		const float cellWidth = static_cast<float>(xMax) / columns;
+		const float cellHeight = static_cast<float>(yMax) / rows;
+		if (cellHeight < diameter)
+		{
+			return false;
+		}
 
-		for (std::uint32_t i = 1; i < rows - 1; ++i)
+		std::uniform_real_distribution<float> jitterXDistr(radius - 0.5f * cellWidth, 0.5f * cellWidth - radius);
+		std::uniform_real_distribution<float> jitterYDistr(radius - 0.5f * cellHeight, 0.5f * cellHeight - radius);
+		for (std::uint32_t i = 0; i < count; ++i)
 		{
-			for (std::uint32_t j = 1; j < columns - 1; ++j)
-			{
-				/*
-				Iterating over all "inside" cells and checking conflicts with neighbouring cells, example 4x4:
-														11 12 13 14
-														8  9  10 11
-														4  5  6  7
-														0  1  2  3
-				currentCellId takes values: 5, 6, 9, 10. For currentCellId = 5, checks for:
-														8 9 10
-														4 5 6
-														0 1 2
-				*/
-				const std::uint32_t currentCellId = i * columns + j;
-
-				resolveCellCollisions(gridCells[currentCellId], gridCells[currentCellId - (columns - 1)], deltaSubStep);
-				resolveCellCollisions(gridCells[currentCellId], gridCells[currentCellId - columns], deltaSubStep);
-				resolveCellCollisions(gridCells[currentCellId], gridCells[currentCellId - (columns + 1)], deltaSubStep);
-
-				resolveCellCollisions(gridCells[currentCellId], gridCells[currentCellId - 1], deltaSubStep);
-				resolveCellCollisions(gridCells[currentCellId], gridCells[currentCellId], deltaSubStep);
-				resolveCellCollisions(gridCells[currentCellId], gridCells[currentCellId + 1], deltaSubStep);
-
-				resolveCellCollisions(gridCells[currentCellId], gridCells[currentCellId + (columns - 1)], deltaSubStep);
-				resolveCellCollisions(gridCells[currentCellId], gridCells[currentCellId + columns], deltaSubStep);
-				resolveCellCollisions(gridCells[currentCellId], gridCells[currentCellId + (columns + 1)], deltaSubStep);
-			}
+			const float x = ((i % columns) + 0.5f) * cellWidth + jitterXDistr(engine);
+			const float y = ((i / columns) + 0.5f) * cellHeight + jitterYDistr(engine);
+			positions[i] = glm::vec2(x, y);
+		}
+		return true;
+	}
+
+	/*
+	Components are sampled from a normal distribution with variance equal to the temperature, then the mean
+	velocity is subtracted and velocities are scaled so that the kinetic energy is exactly particles count * temperature.
+	*/
+	void generateMaxwellBoltzmannVelocities(std::mt19937& engine, const float temperature) noexcept
+	{
+		std::normal_distribution<float> componentDistr(0.f, sqrtf(temperature));
+		glm::dvec2 momentum(0.0);
+		for (std::uint32_t i = 0; i < velocities.size(); ++i)
+		{
+			const glm::vec2 velocity(componentDistr(engine), componentDistr(engine));
+			velocities[i] = velocity;
+			momentum += glm::dvec2(velocity);
+		}
+
+		const glm::vec2 meanVelocity(momentum / static_cast<double>(velocities.size()));
+		double kineticEnergy = 0.0;
+		for (std::uint32_t i = 0; i < velocities.size(); ++i)
+		{
+			const glm::vec2 velocity = static_cast<glm::vec2>(velocities[i]) - meanVelocity;
+			velocities[i] = velocity;
+			kineticEnergy += 0.5 * glm::dot(glm::dvec2(velocity), glm::dvec2(velocity));
 		}
 
-		resolveBoundaryCells(gridCells, columns, rows, deltaSubStep);
+		const float scale = kineticEnergy > 0.0 ? static_cast<float>(sqrt(velocities.size() * static_cast<double>(temperature) / kineticEnergy)) : 0.f;
+		for (std::uint32_t i = 0; i < velocities.size(); ++i)
+		{
+			velocities[i] = static_cast<glm::vec2>(velocities[i]) * scale;
+		}
 	}
 
 public:
-	Physics(PosArrType& positions_, VelArrType& velocities_, const std::uint32_t xMax_, const std::uint32_t yMax_) noexcept : positions(positions_), velocities(velocities_), xMax(xMax_), yMax(yMax_), grid(xMax, yMax)
+	Physics(PosArrType& positions_, VelArrType& velocities_, const std::uint32_t xMax_, const std::uint32_t yMax_, const float radius_) noexcept :
+		positions(positions_), velocities(velocities_), xMax(xMax_), yMax(yMax_),
+		radius(radius_), diameter(2.f * radius_), diameterSquared(4.f * radius_ * radius_), grid(xMax, yMax, radius),
+		narrowPhaseKernel(detectNarrowPhaseKernel()), rowKernel(getNarrowPhaseRowKernel(narrowPhaseKernel))
 	{
 	}
 
-	void generateStartValues() noexcept
+	/*
+	The same seed gives the same start state for a given standard library implementation.
+	*/
+	void generateStartValues(const std::uint32_t seed, const VelocityDistribution velocityDistribution = VelocityDistribution::Uniform,
+		const float temperature = DEFAULT_TEMPERATURE) noexcept
 	{
-		std::random_device rd;
-		std::mt19937 engine(rd());
-
-		std::uniform_int_distribution<std::uint32_t> posXDistr(CIRCLE_RADIUS, xMax - CIRCLE_RADIUS);
-		std::uniform_int_distribution<std::uint32_t> posYDistr(CIRCLE_RADIUS, yMax - CIRCLE_RADIUS);
-
-		std::vector<glm::vec2> tempVec;
-		tempVec.reserve(positions.size());
-		constexpr std::uint32_t MAX_ITER = 1000000;
-		std::uint32_t i = 0;
-		while (tempVec.size() < positions.size())
+		std::mt19937 engine(seed);
+		const float density = 100.f * diameterSquared * positions.size() / (static_cast<float>(xMax) * yMax);
+		if (density > MAX_RANDOM_SPAWN_DENSITY || !spawnRandomly(engine))
 		{
-			++i;
-			auto temp = glm::vec2(posXDistr(engine), posYDistr(engine));
-			if (tempVec.cend() == std::find_if(tempVec.cbegin(), tempVec.cend(), [&temp](const glm::vec2& vec) {return glm::distance(temp, vec) < 2.f * CIRCLE_RADIUS;}))
+			std::cout << "Random insertion can't place all circles at this density, using a jittered lattice.\n";
+			if (!spawnOnLattice(engine))
 			{
-				tempVec.push_back(temp);
+				std::cout << "Can't find nonoverlapping coordinates for circles.\n";
 			}
-			
-			if (i == MAX_ITER)
+		}
+
+		if (velocityDistribution == VelocityDistribution::MaxwellBoltzmann)
+		{
+			generateMaxwellBoltzmannVelocities(engine, temperature);
+		}
+		else
+		{
+			std::uniform_real_distribution<float> velXDistr(vxMin, vxMax);
+			std::uniform_real_distribution<float> velYDistr(vyMin, vyMax);
+			for (std::uint32_t i = 0; i < velocities.size(); ++i)
 			{
-				std::cout << "Can't find nonoverlapping coordinates for a new circle, breaking.\n";
-				break;
+				velocities[i].x = velXDistr(engine);
+				velocities[i].y = velYDistr(engine);
 			}
 		}
-		std::copy(tempVec.begin(), tempVec.end(), positions.begin());
 
-		std::uniform_real_distribution<float> velXDistr(vxMin, vxMax);
-		std::uniform_real_distribution<float> velYDistr(vyMin, vyMax);
-		for (auto& velocity : velocities)
+		initialize();
+	}
+
+	/*
+	Prepares the grid and per particle bookkeeping for current contents of positions and velocities:
+	slots become the stable ids, the iteration counter and the counters of stats start from 0.
+	*/
+	void initialize()
+	{
+		grid.initializeGrid(positions.size());
+		particleIds.resize(positions.size());
+		for (std::uint32_t i = 0; i < particleIds.size(); ++i)
+		{
+			particleIds[i] = i;
+		}
+		neighborStarts.clear();
+		iterationsCount = 0;
+		stats = {};
+	}
+
+	/*
+	threadsCount == 1 resolves collisions serially, 0 uses all hardware threads.
+	*/
+	void setThreadsCount(std::uint32_t threadsCount)
+	{
+		if (threadsCount == 0)
+		{
+			threadsCount = std::max(1u, std::thread::hardware_concurrency());
+		}
+
+		if (threadsCount == getThreadsCount())
+		{
+			return;
+		}
+
+		if (threadsCount == 1)
+		{
+			threadPool.reset();
+			return;
+		}
+		threadPool = std::make_unique<ThreadPool>(threadsCount);
+	}
+
+	std::uint32_t getThreadsCount() const noexcept
+	{
+		return threadPool ? threadPool->getThreadsCount() : 1;
+	}
+
+	/*
+	Lists are dropped when the skin changes, they are rebuilt on the next substep.
+	*/
+	void setNeighborLists(const bool enable, const float skin) noexcept
+	{
+		if (skin != neighborListSkin || enable != useNeighborLists)
 		{
-			velocity.x = velXDistr(engine);
-			velocity.y = velYDistr(engine);
+			neighborStarts.clear();
 		}
+		useNeighborLists = enable;
+		neighborListSkin = skin;
+	}
 
-		grid.initializeGrid();
+	const SimulationStats& getSimulationStats() const noexcept
+	{
+		return stats;
+	}
+
+	void setSubStepsCount(const std::uint32_t subStepsCount_) noexcept
+	{
+		subStepsCount = std::max(1u, subStepsCount_);
+	}
+
+	/*
+	interval == 0 disables reordering.
+	*/
+	void setReorderInterval(const std::uint32_t interval) noexcept
+	{
+		reorderInterval = interval;
+	}
+
+	/*
+	Interior rows use the best kernel the CPU supports by default, the caller checks that a kernel set here is supported.
+	*/
+	void setNarrowPhaseKernel(const NarrowPhaseKernel kernel) noexcept
+	{
+		narrowPhaseKernel = kernel;
+		rowKernel = getNarrowPhaseRowKernel(kernel);
+	}
+
+	NarrowPhaseKernel getNarrowPhaseKernel() const noexcept
+	{
+		return narrowPhaseKernel;
+	}
+
+	const std::vector<std::uint32_t>& getParticleIds() const noexcept
+	{
+		return particleIds;
+	}
+
+	/*
+	Restores stable ids of particles stored in a different order than their creation, call after initialize().
+	*/
+	void setParticleIds(std::vector<std::uint32_t> particleIds_) noexcept
+	{
+		particleIds = std::move(particleIds_);
+	}
+
+	void setIterationsCount(const std::uint64_t iterationsCount_) noexcept
+	{
+		iterationsCount = iterationsCount_;
 	}
 
 	void doIteration() noexcept
 	{
-		std::uint32_t subStepsCount = 5;
-		const float deltaSubStep = DELTA_T / subStepsCount;
+		PROFILE_ZONE("Physics iteration");
+		++iterationsCount;
+		if (reorderInterval != 0 && iterationsCount % reorderInterval == 0)
+		{
+			reorderParticles();
+		}
 
-		while (subStepsCount--)
+		/*
+		With neighbor lists the list update is timed as binning and all pair and wall collisions as interior cells.
+		*/
+		stats.phaseDurations = {};
+		const float deltaSubStep = DELTA_T / subStepsCount;
+		for (std::uint32_t subStep = 0; subStep < subStepsCount; ++subStep)
 		{
-			grid.clearGridCells();
-			for (std::uint32_t i = 0; i < positions.size(); ++i)
+			PROFILE_ZONE("Substep");
+			if (useNeighborLists)
 			{
-				positions[i] += deltaSubStep * velocities[i];
-				grid.addParticleToGridCell(i, positions[i]);
+				{
+					ScopedTimer timer(stats.phaseDurations, Phase::IntegrateAndBin);
+					integratePositions(positions, velocities, deltaSubStep);
+					updateNeighborLists();
+				}
+				ScopedTimer timer(stats.phaseDurations, Phase::InteriorCells);
+				stats.collisionsCount += resolveNeighborListCollisions(deltaSubStep);
+				continue;
 			}
 
-			resolveCollisions(deltaSubStep);
+			{
+				ScopedTimer timer(stats.phaseDurations, Phase::GridClear);
+				grid.clearGridCells();
+			}
+			{
+				ScopedTimer timer(stats.phaseDurations, Phase::IntegrateAndBin);
+				integratePositions(positions, velocities, deltaSubStep);
+				binParticles();
+			}
+			stats.collisionsCount += resolveCollisions(deltaSubStep);
 		}
 	}
 };
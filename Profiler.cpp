@@ -0,0 +1,127 @@
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+	constexpr std::uint32_t ZONES_PER_THREAD = 1 << 15;
+
+	struct ProfileEvent
+	{
+		const char* name;
+		std::uint64_t startNs;
+		std::uint64_t endNs;
+	};
+
+	struct ThreadZones
+	{
+		std::uint32_t threadId = 0;
+		std::atomic<std::uint64_t> zonesCount = 0;
+		std::array<ProfileEvent, ZONES_PER_THREAD> zones;
+	};
+
+	/*
+	Buffers are owned by the registry, so zones of finished threads (e.g. workers of a resized pool) stay in the trace.
+	*/
+	std::mutex registryMutex;
+	std::vector<std::unique_ptr<ThreadZones>> registry;
+
+	ThreadZones& getThreadZones() noexcept
+	{
+		thread_local ThreadZones* threadZones = nullptr;
+		if (threadZones == nullptr)
+		{
+			std::lock_guard<std::mutex> lock(registryMutex);
+			registry.push_back(std::make_unique<ThreadZones>());
+			threadZones = registry.back().get();
+			threadZones->threadId = static_cast<std::uint32_t>(registry.size() - 1);
+		}
+		return *threadZones;
+	}
+}
+
+void recordProfileZone(const char* name, const std::uint64_t startNs, const std::uint64_t endNs) noexcept
+{
+	ThreadZones& threadZones = getThreadZones();
+	const std::uint64_t zonesCount = threadZones.zonesCount.load(std::memory_order_relaxed);
+	threadZones.zones[zonesCount % ZONES_PER_THREAD] = { name, startNs, endNs };
+	threadZones.zonesCount.store(zonesCount + 1, std::memory_order_release);
+}
+
+bool writeChromeTrace(const std::string& path) noexcept
+{
+	std::ofstream file(path);
+	if (!file)
+	{
+		std::cout << "Can't open trace file " << path << "\n";
+		return false;
+	}
+
+	/*
+	Zones are copied before writing, zones overwritten by their thread during the copy are dropped,
+	so the trace can be written while other threads keep recording.
+	*/
+	std::lock_guard<std::mutex> lock(registryMutex);
+	std::vector<std::vector<ProfileEvent>> threadsEvents(registry.size());
+	std::uint64_t firstStartNs = std::numeric_limits<std::uint64_t>::max();
+	for (std::size_t t = 0; t < registry.size(); ++t)
+	{
+		const ThreadZones& threadZones = *registry[t];
+		const std::uint64_t zonesCount = threadZones.zonesCount.load(std::memory_order_acquire);
+		const std::uint64_t firstZone = zonesCount - std::min<std::uint64_t>(zonesCount, ZONES_PER_THREAD);
+		std::vector<ProfileEvent>& events = threadsEvents[t];
+		for (std::uint64_t i = firstZone; i < zonesCount; ++i)
+		{
+			events.push_back(threadZones.zones[i % ZONES_PER_THREAD]);
+		}
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		/*
+		The zone being recorded right now may already overwrite the slot after the last counted one.
+		*/
+		const std::uint64_t writtenCount = threadZones.zonesCount.load(std::memory_order_relaxed) + 1;
+		const std::uint64_t firstIntactZone = writtenCount - std::min<std::uint64_t>(writtenCount, ZONES_PER_THREAD);
+		const std::uint64_t overwrittenCount = std::min<std::uint64_t>(events.size(), firstIntactZone - std::min(firstIntactZone, firstZone));
+		events.erase(events.begin(), events.begin() + overwrittenCount);
+		for (const ProfileEvent& event : events)
+		{
+			firstStartNs = std::min(firstStartNs, event.startNs);
+		}
+	}
+
+	/*
+	Timestamps of complete ("X") events are microseconds since the oldest recorded zone.
+	*/
+	std::uint64_t eventsCount = 0;
+	file << "{\"traceEvents\": [\n" << std::fixed << std::setprecision(3);
+	for (std::size_t t = 0; t < registry.size(); ++t)
+	{
+		const std::uint32_t threadId = registry[t]->threadId;
+		file << (eventsCount++ == 0 ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": " << threadId
+			<< ", \"args\": {\"name\": \"Thread " << threadId << "\"}}";
+
+		for (const ProfileEvent& zone : threadsEvents[t])
+		{
+			file << ",\n{\"name\": \"" << zone.name << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << threadId
+				<< ", \"ts\": " << (zone.startNs - firstStartNs) / 1000.0 << ", \"dur\": " << (zone.endNs - zone.startNs) / 1000.0 << "}";
+			++eventsCount;
+		}
+	}
+	file << "\n]}\n";
+
+	if (!file)
+	{
+		std::cout << "Writing trace file " << path << " failed\n";
+		return false;
+	}
+	std::cout << "Chrome trace with " << eventsCount << " events written to " << path << "\n";
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/*
+Zones are recorded only while the profiler is enabled, a disabled zone costs one relaxed load.
+Defining DISABLE_PROFILER removes zones from the build entirely.
+*/
+inline std::atomic<bool> profilerEnabled = false;
+
+inline void setProfilerEnabled(const bool enabled) noexcept
+{
+	profilerEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+inline bool isProfilerEnabled() noexcept
+{
+	return profilerEnabled.load(std::memory_order_relaxed);
+}
+
+inline std::uint64_t getProfilerTimeNs() noexcept
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+Appends a finished zone to the ring buffer of the calling thread, the oldest zones are overwritten when it's full.
+Only the owning thread writes to its buffer, so recording doesn't take any lock after the first zone of a thread.
+*/
+void recordProfileZone(const char* name, const std::uint64_t startNs, const std::uint64_t endNs) noexcept;
+
+/*
+Writes zones of all threads as Chrome trace-event JSON (chrome://tracing, Perfetto).
+Can be called while other threads record, zones they overwrite meanwhile are left out.
+*/
+bool writeChromeTrace(const std::string& path) noexcept;
+
+class ProfileZone
+{
+private:
+	const char* const name;
+	const std::uint64_t startNs;
+
+public:
+	explicit ProfileZone(const char* name_) noexcept : name(name_), startNs(isProfilerEnabled() ? getProfilerTimeNs() : 0)
+	{
+	}
+
+	~ProfileZone()
+	{
+		if (startNs != 0)
+		{
+			recordProfileZone(name, startNs, getProfilerTimeNs());
+		}
+	}
+
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+};
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+
+#ifdef DISABLE_PROFILER
+#define PROFILE_ZONE(name)
+#else
+#define PROFILE_ZONE(name) const ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#endif
+
+#endif
\ No newline at end of file
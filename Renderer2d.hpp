@@ -8,10 +8,22 @@
 #include "Constants.hpp"
 #include "Shaders.hpp"
 #include "ImGuiHandler.hpp"
+#include "ParticleArrays.hpp"
+#include "StreamBuffer.hpp"
+#include "FrameCapture.hpp"
+#include "OffscreenContext.hpp"
+#include "Config.hpp"
+#include "PhaseTimings.hpp"
+#include "Profiler.hpp"
 
+#include <algorithm>
+#include <array>
 #include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <type_traits>
 #include <vector>
-#include <numbers>
 #include <iostream>
 
 inline void glfwError(int id, const char* description)
@@ -23,98 +35,232 @@ template<typename PosArrType, typename VelArrType>
 class Renderer2d
 {
 private:
-	const PosArrType& positions;
-	const VelArrType& velocities;
+	const std::uint32_t particlesCount;
 	const std::uint32_t xMax;
 	const std::uint32_t yMax;
+	const float radius;
+	const std::uint32_t fieldWidth;
+	const std::uint32_t fieldHeight;
+	const CaptureConfig capture;
 
+	static constexpr std::uint32_t MAX_WINDOW_WIDTH = 1920;
+	static constexpr std::uint32_t MAX_WINDOW_HEIGHT = 1080;
+
+	/*
+	Null with a surfaceless context, there is no window, no events and no control panel.
+	*/
 	GLFWwindow* window;
-	GLuint vertexBuffer, vertexArray, indexBuffer;
+	OffscreenContext offscreenContext;
+	GLuint vertexArray, quadBuffer, colormapTexture, fieldTexture;
+	StreamBuffer instanceStream;
+
+	Shaders particleShaders;
+	Shaders fieldShaders;
+	GLuint programId, fieldProgramId;
+	GLint speedRangeLocation, useColormapLocation, fieldSpeedRangeLocation, showThermalSpeedLocation;
 
-	Shaders shader;
-	std::array<glm::vec2, TRIANGLES_PER_CIRCLE> circlePoints;
-	std::vector<glm::vec2> circleVerticies;
-	std::vector<std::uint32_t> indices;
+	/*
+	Viridis sampled at equal steps, interpolated linearly into the colormap texture.
+	*/
+	static constexpr std::uint32_t COLORMAP_SIZE = 256;
+	static constexpr std::array<std::array<std::uint8_t, 3>, 9> COLORMAP_STOPS = { {
+		{ 68, 1, 84 }, { 71, 45, 123 }, { 59, 82, 139 }, { 44, 114, 142 }, { 33, 145, 140 },
+		{ 40, 174, 128 }, { 94, 201, 98 }, { 173, 220, 48 }, { 253, 231, 37 } } };
 
 	ImGuiHandler<VelArrType> imGuiHandler;
+	std::unique_ptr<FrameCapture> frameCapture;
+
+	/*
+	Per particle vectors are uploaded in the storage format of the layout, interleaved for AoS and
+	all x components followed by all y components for SoA. Shaders read the components as two float attributes.
+	*/
+	template<typename ArrType>
+	void setVectorAttributes(const GLuint xLocation, const GLuint yLocation, const std::uintptr_t offset) noexcept
+	{
+		if constexpr (std::is_same_v<ArrType, Vec2ArraySoA>)
+		{
+			glVertexAttribPointer(xLocation, 1, GL_FLOAT, GL_FALSE, sizeof(float), reinterpret_cast<const void*>(offset));
+			glVertexAttribPointer(yLocation, 1, GL_FLOAT, GL_FALSE, sizeof(float), reinterpret_cast<const void*>(offset + sizeof(float) * particlesCount));
+		}
+		else
+		{
+			glVertexAttribPointer(xLocation, 1, GL_FLOAT, GL_FALSE, 2 * sizeof(float), reinterpret_cast<const void*>(offset));
+			glVertexAttribPointer(yLocation, 1, GL_FLOAT, GL_FALSE, 2 * sizeof(float), reinterpret_cast<const void*>(offset + sizeof(float)));
+		}
+		for (const GLuint location : { xLocation, yLocation })
+		{
+			glVertexAttribDivisor(location, 1);
+			glEnableVertexAttribArray(location);
+		}
+	}
 
+	template<typename ArrType>
+	void writeVectors(const ArrType& vectors, std::uint8_t* data) noexcept
+	{
+		vectors.forEachBuffer([&data](const auto& buffer)
+		{
+			const std::size_t bytes = buffer.size() * sizeof(*buffer.data());
+			std::memcpy(data, buffer.data(), bytes);
+			data += bytes;
+		});
+	}
+
+	/*
+	The latest state is copied straight into the mapped buffer, attributes are pointed at the written segment.
+	Velocities follow positions in the segment and are only written when the colormap needs them.
+	*/
+	void uploadInstances(const PosArrType& positions, const VelArrType& velocities, const bool withVelocities) noexcept
+	{
+		const std::uintptr_t velocitiesOffset = 2 * sizeof(float) * particlesCount;
+		glBindVertexArray(vertexArray);
+		if (void* data = instanceStream.beginWrite())
+		{
+			writeVectors(positions, static_cast<std::uint8_t*>(data));
+			if (withVelocities)
+			{
+				writeVectors(velocities, static_cast<std::uint8_t*>(data) + velocitiesOffset);
+			}
+		}
+
+		const GLintptr offset = instanceStream.endWrite();
+		setVectorAttributes<PosArrType>(1, 2, offset);
+		if (withVelocities)
+		{
+			setVectorAttributes<VelArrType>(3, 4, offset + velocitiesOffset);
+		}
+		else
+		{
+			glDisableVertexAttribArray(3);
+			glDisableVertexAttribArray(4);
+		}
+	}
+
+	void createColormapTexture() noexcept
+	{
+		std::array<std::array<std::uint8_t, 3>, COLORMAP_SIZE> texels;
+		for (std::uint32_t i = 0; i < COLORMAP_SIZE; ++i)
+		{
+			const float position = static_cast<float>(i) / (COLORMAP_SIZE - 1) * (COLORMAP_STOPS.size() - 1);
+			const std::uint32_t stop = std::min(static_cast<std::uint32_t>(position), static_cast<std::uint32_t>(COLORMAP_STOPS.size() - 2));
+			const float weight = position - stop;
+			for (std::uint32_t channel = 0; channel < 3; ++channel)
+			{
+				const float value = (1.f - weight) * COLORMAP_STOPS[stop][channel] + weight * COLORMAP_STOPS[stop + 1][channel];
+				texels[i][channel] = static_cast<std::uint8_t>(value + 0.5f);
+			}
+		}
+
+		glGenTextures(1, &colormapTexture);
+		glBindTexture(GL_TEXTURE_1D, colormapTexture);
+		glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage1D(GL_TEXTURE_1D, 0, GL_RGB8, COLORMAP_SIZE, 0, GL_RGB, GL_UNSIGNED_BYTE, texels.data());
+	}
+
+	/*
+	Every particle is an instance of a quad covering its circle, the fragment shader discards the corners.
+	*/
 	bool prepareBuffersAndShaders()
 	{
-		const std::uint32_t nrOfVertices = TRIANGLES_PER_CIRCLE * positions.size();
-		circleVerticies = std::vector<glm::vec2>(nrOfVertices);
-		std::cout << "Numbers of particles: " << positions.size() << "\n";
+		std::cout << "Numbers of particles: " << particlesCount << "\n";
 
 		glGenVertexArrays(1, &vertexArray);
 		glBindVertexArray(vertexArray);
 
-		glGenBuffers(1, &vertexBuffer);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-		glBufferData(GL_ARRAY_BUFFER, 2 * sizeof(float) * nrOfVertices, nullptr, GL_DYNAMIC_DRAW);
-
+		constexpr std::array<glm::vec2, 4> quadCorners = { glm::vec2(-1.f, -1.f), glm::vec2(1.f, -1.f), glm::vec2(-1.f, 1.f), glm::vec2(1.f, 1.f) };
+		glGenBuffers(1, &quadBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, quadBuffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(quadCorners), quadCorners.data(), GL_STATIC_DRAW);
 		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), 0);
 		glEnableVertexAttribArray(0);
 
-		indices.reserve(VERTICES_PER_CIRCLE * positions.size());
-		for (std::uint32_t j = 0; j < positions.size(); ++j)
+		if (!instanceStream.initialize(4 * sizeof(float) * particlesCount))
 		{
-			std::uint32_t index = j * TRIANGLES_PER_CIRCLE;
-			for (std::uint32_t i = 0; i < TRIANGLES_PER_CIRCLE - 2; ++i)
-			{
-				indices.push_back(index);
-				indices.push_back(index + i + 1);
-				indices.push_back(index + i + 2);
-			}
+			return false;
 		}
+		createColormapTexture();
 
-		const float radius_x = CIRCLE_RADIUS * 2.f / xMax;
-		const float radius_y = CIRCLE_RADIUS * 2.f / yMax;
-		constexpr float angle = 2.f * std::numbers::pi_v<float> / TRIANGLES_PER_CIRCLE;
-		for (std::uint32_t i = 0; i < TRIANGLES_PER_CIRCLE; ++i)
+		glGenTextures(1, &fieldTexture);
+		glBindTexture(GL_TEXTURE_2D, fieldTexture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, fieldWidth, fieldHeight, 0, GL_RG, GL_FLOAT, nullptr);
+
+		auto fieldProgram = fieldShaders.getProgramId();
+		if (!fieldProgram)
 		{
-			float currentAngle = i * angle;
-			circlePoints[i] = { radius_x * cosf(currentAngle), radius_y * sinf(currentAngle) };
+			return false;
 		}
+		fieldProgramId = fieldProgram.value();
+		fieldSpeedRangeLocation = glGetUniformLocation(fieldProgramId, "speedRange");
+		showThermalSpeedLocation = glGetUniformLocation(fieldProgramId, "showThermalSpeed");
 
-		glGenBuffers(1, &indexBuffer);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), &indices[0], GL_STATIC_DRAW);
-
-		auto programId = shader.getProgramId();
-		if (programId)
+		auto program = particleShaders.getProgramId();
+		if (program)
 		{
-			glUseProgram(programId.value());
+			programId = program.value();
+			glUseProgram(programId);
+			glUniform2f(glGetUniformLocation(programId, "worldSize"), static_cast<float>(xMax), static_cast<float>(yMax));
+			glUniform1f(glGetUniformLocation(programId, "radius"), radius);
+			speedRangeLocation = glGetUniformLocation(programId, "speedRange");
+			useColormapLocation = glGetUniformLocation(programId, "useColormap");
 			return true;
 		}
 		return false;
 	}
 
-	void translateAndMakeCircles()
+	void uploadDensityField(const std::vector<glm::vec2>& densityField) noexcept
 	{
-		const float xScale = xMax / 2.f;
-		const float yScale = yMax / 2.f;
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, fieldTexture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, fieldWidth, fieldHeight, GL_RG, GL_FLOAT, densityField.data());
+		glActiveTexture(GL_TEXTURE0);
+	}
 
-		std::uint32_t j = 0, k = 0;
-		glm::vec2 center = { (positions[0].x - xScale) / xScale, (positions[0].y - yScale) / yScale };
-		for (std::uint32_t i = 0; i < circleVerticies.size(); ++i)
-		{
-			circleVerticies[i] = circlePoints[k] + center;
-			++k;
-			if (k != 0 && k % TRIANGLES_PER_CIRCLE == 0)
-			{
-				++j;
-				center = { (positions[j].x - xScale) / xScale, (positions[j].y - yScale) / yScale };
-				k = 0;
-			}
-		}
+	void drawParticles(const RenderSettings& renderSettings) noexcept
+	{
+		glUseProgram(programId);
+		glUniform1i(useColormapLocation, renderSettings.coloring == ParticleColoring::Speed);
+		glUniform2f(speedRangeLocation, renderSettings.minSpeed, renderSettings.maxSpeed);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_1D, colormapTexture);
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, particlesCount);
+		instanceStream.fenceSegment();
 	}
 
-public:
-	Renderer2d(const PosArrType& positions_, const VelArrType& velocities_, const std::uint32_t xMax_, const std::uint32_t yMax_) noexcept :
-		positions(positions_), velocities(velocities_), xMax(xMax_), yMax(yMax_), window(nullptr), imGuiHandler(velocities)
+	void drawDensityField(const RenderSettings& renderSettings) noexcept
 	{
+		glUseProgram(fieldProgramId);
+		glUniform1i(showThermalSpeedLocation, renderSettings.coloring == ParticleColoring::Speed);
+		glUniform2f(fieldSpeedRangeLocation, renderSettings.minSpeed, renderSettings.maxSpeed);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, fieldTexture);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_1D, colormapTexture);
+		glBindVertexArray(vertexArray);
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 	}
 
-	bool initialize()
+	/*
+	GLEW built for GLX reports a missing GLX display under an EGL context, after it has loaded the GL entry points.
+	*/
+	bool initializeGlew() noexcept
+	{
+		const GLenum result = glewInit();
+		if (result != GLEW_OK && !(window == nullptr && result == GLEW_ERROR_NO_GLX_DISPLAY))
+		{
+			std::cout << "glewInit() failed\n";
+			return false;
+		}
+		return true;
+	}
+
+	bool createWindow(const int windowWidth, const int windowHeight)
 	{
 		glfwSetErrorCallback(&glfwError);
 
@@ -125,7 +271,11 @@ public:
 		}
 
 		glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-		window = glfwCreateWindow(xMax, yMax, "Elastic 2d collisions", NULL, NULL);
+		if (capture.offscreen)
+		{
+			glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		}
+		window = glfwCreateWindow(windowWidth, windowHeight, "Elastic 2d collisions", NULL, NULL);
 		if (window == nullptr)
 		{
 			std::cout << "window nullptr\n";
@@ -133,49 +283,202 @@ public:
 			return false;
 		}
 		glfwMakeContextCurrent(window);
-		glfwSwapInterval(1);
-		if (GLEW_OK != glewInit())
+		glfwSwapInterval(capture.offscreen ? 0 : 1);
+		return true;
+	}
+
+public:
+	Renderer2d(const std::uint32_t particlesCount_, const std::uint32_t xMax_, const std::uint32_t yMax_, const float radius_,
+		const std::uint32_t fieldWidth_, const std::uint32_t fieldHeight_, const SimulationSettings& settings, const RenderSettings& renderSettings,
+		const CaptureConfig& capture_) :
+		particlesCount(particlesCount_), xMax(xMax_), yMax(yMax_), radius(radius_), fieldWidth(fieldWidth_), fieldHeight(fieldHeight_), capture(capture_), window(nullptr),
+		particleShaders(Shaders::createParticleShaders()), fieldShaders(Shaders::createDensityFieldShaders()), programId(0), fieldProgramId(0),
+		imGuiHandler(particlesCount, radius, settings, renderSettings)
+	{
+	}
+
+	/*
+	Domains larger than the screen are scaled down keeping the aspect ratio, returns pixels per world unit.
+	*/
+	static float getWindowScale(const std::uint32_t xMax, const std::uint32_t yMax) noexcept
+	{
+		return std::min({ 1.f, static_cast<float>(MAX_WINDOW_WIDTH) / xMax, static_cast<float>(MAX_WINDOW_HEIGHT) / yMax });
+	}
+
+	/*
+	Decided every frame from the ratio set in the control panel, physics thread builds the field only when it's drawn.
+	*/
+	bool drawsDensityField() const noexcept
+	{
+		const float windowScale = getWindowScale(xMax, yMax);
+		const double pixelsCount = static_cast<double>(windowScale * xMax) * (windowScale * yMax);
+		return particlesCount > imGuiHandler.getRenderSettings().densityFieldRatio * pixelsCount;
+	}
+
+	bool initialize()
+	{
+		const float windowScale = getWindowScale(xMax, yMax);
+		const int windowWidth = std::max(1, static_cast<int>(windowScale * xMax));
+		const int windowHeight = std::max(1, static_cast<int>(windowScale * yMax));
+
+		if (capture.contextApi == ContextApi::Surfaceless ? !offscreenContext.create() : !createWindow(windowWidth, windowHeight))
 		{
-			std::cout << "glewInit() failed\n";
 			return false;
 		}
-		
-		imGuiHandler.initialize(window);
+		if (!initializeGlew())
+		{
+			return false;
+		}
+
+		if (!capture.path.empty())
+		{
+			int captureWidth = windowWidth, captureHeight = windowHeight;
+			if (!capture.offscreen)
+			{
+				glfwGetFramebufferSize(window, &captureWidth, &captureHeight);
+			}
+			frameCapture = std::make_unique<FrameCapture>(capture);
+			if (!frameCapture->initialize(captureWidth, captureHeight))
+			{
+				return false;
+			}
+		}
+
+		if (window != nullptr)
+		{
+			imGuiHandler.initialize(window);
+		}
 		return prepareBuffersAndShaders();
 	}
 
-	void render() noexcept
+	/*
+	Draws the given state, which has to stay unchanged until render() returns. The density field is drawn
+	instead of particles when it's enabled and was built for this state.
+	*/
+	void render(const PosArrType& positions, const VelArrType& velocities, const std::vector<glm::vec2>& densityField, const std::uint64_t iteration) noexcept
 	{
-		glfwMakeContextCurrent(window);
-		glfwPollEvents();
-		translateAndMakeCircles();
-		glBufferSubData(GL_ARRAY_BUFFER, 0, 2 * sizeof(float) * circleVerticies.size(), circleVerticies.data());
+		PROFILE_ZONE("Render frame");
+		if (window != nullptr)
+		{
+			glfwMakeContextCurrent(window);
+			glfwPollEvents();
+		}
+		if (frameCapture)
+		{
+			frameCapture->bindFramebuffer();
+		}
+
+		/*
+		Timers measure CPU time of the calls, GPU work queued by them is only visible in the swap
+		and in the buffer upload when it waits for the GPU to release a segment.
+		*/
+		PhaseDurations durations;
+		const RenderSettings& renderSettings = imGuiHandler.getRenderSettings();
+		const bool showDensityField = drawsDensityField() && densityField.size() == fieldWidth * fieldHeight;
+		{
+			ScopedTimer timer(durations, Phase::BufferUpload);
+			if (showDensityField)
+			{
+				uploadDensityField(densityField);
+			}
+			else
+			{
+				uploadInstances(positions, velocities, renderSettings.coloring == ParticleColoring::Speed);
+			}
+		}
 
 		glClear(GL_COLOR_BUFFER_BIT);
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-		imGuiHandler.render();
-		glfwSwapBuffers(window);
+		if (showDensityField)
+		{
+			drawDensityField(renderSettings);
+		}
+		else
+		{
+			drawParticles(renderSettings);
+		}
+		if (frameCapture)
+		{
+			PROFILE_ZONE("Capture frame");
+			frameCapture->captureFrame(iteration);
+		}
+
+		/*
+		Offscreen frames have no control panel and nothing to present.
+		*/
+		if (!capture.offscreen)
+		{
+			{
+				ScopedTimer timer(durations, Phase::ImGuiRender);
+				imGuiHandler.render(velocities);
+			}
+			{
+				PROFILE_ZONE("Swap buffers");
+				ScopedTimer timer(durations, Phase::SwapBuffers);
+				glfwSwapBuffers(window);
+			}
+		}
+		imGuiHandler.addFrameDurations(durations);
 	}
 
 	bool isWindowActive() noexcept
 	{
-		return !glfwWindowShouldClose(window);
+		return !(window != nullptr && glfwWindowShouldClose(window)) && !(frameCapture && frameCapture->isFinished());
+	}
+
+	bool isOffscreen() const noexcept
+	{
+		return capture.offscreen;
 	}
 
 	void cleanup() noexcept
 	{
-		imGuiHandler.cleanup();
-		glDeleteBuffers(1, &indexBuffer);
-		glDeleteBuffers(1, &vertexBuffer);
+		if (frameCapture)
+		{
+			frameCapture->cleanup();
+		}
+		if (window != nullptr)
+		{
+			imGuiHandler.cleanup();
+		}
+		instanceStream.cleanup();
+		glDeleteTextures(1, &fieldTexture);
+		glDeleteTextures(1, &colormapTexture);
+		glDeleteProgram(fieldProgramId);
+		glDeleteProgram(programId);
+		glDeleteBuffers(1, &quadBuffer);
 		glDeleteVertexArrays(1, &vertexArray);
-		glfwDestroyWindow(window);
-		glfwTerminate();
+		if (window != nullptr)
+		{
+			glfwDestroyWindow(window);
+			glfwTerminate();
+		}
+		offscreenContext.destroy();
 	}
 
 	bool pauseSimulation() noexcept
 	{
 		return imGuiHandler.pauseSimulation();
 	}
+
+	const SimulationSettings& getSimulationSettings() const noexcept
+	{
+		return imGuiHandler.getSimulationSettings();
+	}
+
+	void setSimulationStats(const SimulationStats& stats) noexcept
+	{
+		imGuiHandler.setSimulationStats(stats);
+	}
+
+	CheckpointRequest takeCheckpointRequest() noexcept
+	{
+		return imGuiHandler.takeCheckpointRequest();
+	}
+
+	std::string getCheckpointPath() const
+	{
+		return imGuiHandler.getCheckpointPath();
+	}
 };
 
 #endif
\ No newline at end of file
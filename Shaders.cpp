@@ -1,22 +1,89 @@
 #include "Shaders.hpp"
 
 #include <iostream>
+#include <utility>
 
-Shaders::Shaders()
+Shaders::Shaders(std::string vertexShader_, std::string fragmentShader_, std::vector<std::pair<std::string, GLint>> samplerUnits_) noexcept :
+	fragmentShader(std::move(fragmentShader_)), vertexShader(std::move(vertexShader_)), samplerUnits(std::move(samplerUnits_))
 {
-	vertexShader = "#version 330 core\n"
-		"layout(location = 0) in vec4 positions;\n"
+}
+
+Shaders Shaders::createParticleShaders()
+{
+	/*
+	Corners of the shared quad are scaled by the radius and moved to the particle center given in world coordinates.
+	Speed is computed from the velocity attributes and normalized to the colormap range.
+	*/
+	const std::string vertexShader = "#version 330 core\n"
+		"layout(location = 0) in vec2 corner;\n"
+		"layout(location = 1) in float centerX;\n"
+		"layout(location = 2) in float centerY;\n"
+		"layout(location = 3) in float velocityX;\n"
+		"layout(location = 4) in float velocityY;\n"
+		"uniform vec2 worldSize;\n"
+		"uniform float radius;\n"
+		"uniform vec2 speedRange;\n"
+		"out vec2 circleCoordinates;\n"
+		"out float colormapCoordinate;\n"
+		"void main()\n"
+		"{\n"
+		"	circleCoordinates = corner;\n"
+		"	float speed = length(vec2(velocityX, velocityY));\n"
+		"	colormapCoordinate = clamp((speed - speedRange.x) / max(speedRange.y - speedRange.x, 1e-6), 0.0, 1.0);\n"
+		"	vec2 position = vec2(centerX, centerY) + radius * corner;\n"
+		"	gl_Position = vec4(2.0 * position / worldSize - 1.0, 0.0, 1.0);\n"
+		"}\n";
+
+	/*
+	Signed distance to the circle edge in radius units, fragments outside of the circle are discarded.
+	*/
+	const std::string fragmentShader = "#version 330 core\n"
+		"in vec2 circleCoordinates;\n"
+		"in float colormapCoordinate;\n"
+		"uniform bool useColormap;\n"
+		"uniform sampler1D colormap;\n"
+		"layout(location = 0) out vec4 color;\n"
 		"void main()\n"
 		"{\n"
-		"	gl_Position = positions;\n"
+		"	float distance = length(circleCoordinates) - 1.0;\n"
+		"	if (distance > 0.0)\n"
+		"	{\n"
+		"		discard;\n"
+		"	}\n"
+		"	color = useColormap ? texture(colormap, colormapCoordinate) : vec4(1.0, 1.0, 1.0, 1.0);\n"
+		"}\n";
+	return Shaders(vertexShader, fragmentShader, { { "colormap", 0 } });
+}
+
+Shaders Shaders::createDensityFieldShaders()
+{
+	const std::string vertexShader = "#version 330 core\n"
+		"layout(location = 0) in vec2 corner;\n"
+		"out vec2 fieldCoordinates;\n"
+		"void main()\n"
+		"{\n"
+		"	fieldCoordinates = 0.5 * corner + 0.5;\n"
+		"	gl_Position = vec4(corner, 0.0, 1.0);\n"
 		"}\n";
 
-	fragmentShader = "#version 330 core\n"
+	/*
+	Red channel is density relative to the mean, mapped so that the mean is in the middle of the colormap.
+	Green channel is thermal speed, mapped with the speed range of the particles.
+	*/
+	const std::string fragmentShader = "#version 330 core\n"
+		"in vec2 fieldCoordinates;\n"
+		"uniform sampler2D field;\n"
+		"uniform sampler1D colormap;\n"
+		"uniform bool showThermalSpeed;\n"
+		"uniform vec2 speedRange;\n"
 		"layout(location = 0) out vec4 color;\n"
 		"void main()\n"
 		"{\n"
-		"	color = vec4(1.0, 1.0, 1.0, 1.0);\n"
+		"	vec2 texel = texture(field, fieldCoordinates).rg;\n"
+		"	float value = showThermalSpeed ? (texel.g - speedRange.x) / max(speedRange.y - speedRange.x, 1e-6) : 0.5 * texel.r;\n"
+		"	color = texture(colormap, clamp(value, 0.0, 1.0));\n"
 		"}\n";
+	return Shaders(vertexShader, fragmentShader, { { "colormap", 0 }, { "field", 1 } });
 }
 
 std::optional<GLuint> Shaders::compileShader(const std::string_view shader, const GLenum shaderType) noexcept
@@ -85,6 +152,11 @@ std::optional<GLuint> Shaders::getProgramId() noexcept
 		return std::nullopt;
 	}
 
+	glUseProgram(programId);
+	for (const auto& [name, unit] : samplerUnits)
+	{
+		glUniform1i(glGetUniformLocation(programId, name.c_str()), unit);
+	}
 	glValidateProgram(programId);
 	if (!queryGetProgramStatus(programId, GL_VALIDATE_STATUS))
 	{
@@ -6,16 +6,34 @@
 #include <optional>
 #include <string>
 #include <string_view>
+#include <utility>
+#include <vector>
 
 class Shaders
 {
 private:
 	std::string fragmentShader;
 	std::string vertexShader;
+	std::vector<std::pair<std::string, GLint>> samplerUnits;
 	std::optional<GLuint> compileShader(const std::string_view shader, const GLenum shaderType) noexcept;
 	bool queryGetProgramStatus(const GLuint programId, const GLenum infoType) noexcept;
 public:
-	Shaders();
+	/*
+	Samplers are set to their texture units right after linking. Validation checks the program against the current
+	uniform values and fails while samplers of different types share the default unit 0.
+	*/
+	Shaders(std::string vertexShader_, std::string fragmentShader_, std::vector<std::pair<std::string, GLint>> samplerUnits_ = {}) noexcept;
+
+	/*
+	Instanced circles, optionally colored by speed.
+	*/
+	static Shaders createParticleShaders();
+
+	/*
+	Full window heatmap of the density field texture.
+	*/
+	static Shaders createDensityFieldShaders();
+
 	std::optional<GLuint> getProgramId() noexcept;
 };
 
@@ -0,0 +1,276 @@
+#ifndef SIMULATION_HPP
+#define SIMULATION_HPP
+
+#include "Physics.hpp"
+#include "EventDrivenPhysics.hpp"
+#include "ParticleArrays.hpp"
+#include "SimulationSettings.hpp"
+#include "Config.hpp"
+#include "Checkpoint.hpp"
+
+#include <glm/vec2.hpp>
+#include <glm/geometric.hpp>
+
+#include <bit>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+Summary of the particle state used to compare runs: checksum is equal only for bit exact states,
+energy and momentum show how far diverged runs are.
+*/
+struct StateSummary
+{
+	std::uint64_t checksum;
+	double kineticEnergy;
+	glm::dvec2 momentum;
+};
+
+inline std::uint64_t mixBits(std::uint64_t value) noexcept
+{
+	value += 0x9E3779B97F4A7C15ull;
+	value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+	value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+	return value ^ (value >> 31);
+}
+
+/*
+Particle state together with both physics engines, shared by the windowed World and the headless runner.
+Settings are applied before every iteration, switching to the event driven engine rebuilds its state.
+*/
+template<typename Layout = AosLayout>
+class Simulation
+{
+private:
+	typename Layout::Vec2Array positions;
+	typename Layout::Vec2Array velocities;
+	Physics<typename Layout::Vec2Array, typename Layout::Vec2Array> physicsEngine;
+	EventDrivenPhysics<typename Layout::Vec2Array, typename Layout::Vec2Array> eventDrivenEngine;
+	PhysicsEngineType activeEngineType = PhysicsEngineType::TimeStepping;
+	const WorldConfig world;
+	std::uint32_t seed = 0;
+	std::uint64_t iterationsCount = 0;
+
+public:
+	using Vec2Array = typename Layout::Vec2Array;
+
+	Simulation(const WorldConfig& config) : positions(config.getParticlesCount()), velocities(config.getParticlesCount()),
+		physicsEngine(positions, velocities, config.xMax, config.yMax, config.radius),
+		eventDrivenEngine(positions, velocities, config.xMax, config.yMax, config.radius), world(config)
+	{
+	}
+
+	void generateStartValues(const std::uint32_t seed_, const VelocityDistribution velocityDistribution = VelocityDistribution::Uniform,
+		const float temperature = DEFAULT_TEMPERATURE) noexcept
+	{
+		physicsEngine.generateStartValues(seed_, velocityDistribution, temperature);
+		seed = seed_;
+		iterationsCount = 0;
+		if (activeEngineType == PhysicsEngineType::EventDriven)
+		{
+			eventDrivenEngine.initialize();
+		}
+	}
+
+	void doIteration(const SimulationSettings& settings)
+	{
+		++iterationsCount;
+		if (settings.engineType != activeEngineType)
+		{
+			activeEngineType = settings.engineType;
+			if (activeEngineType == PhysicsEngineType::EventDriven)
+			{
+				eventDrivenEngine.initialize();
+			}
+			else
+			{
+				/*
+				Iterations of the event driven engine weren't counted by the time stepping one, its reorder schedule follows this count.
+				*/
+				physicsEngine.setIterationsCount(iterationsCount - 1);
+			}
+		}
+
+		if (activeEngineType == PhysicsEngineType::EventDriven)
+		{
+			eventDrivenEngine.doIteration();
+			return;
+		}
+		physicsEngine.setThreadsCount(settings.threadsCount);
+		physicsEngine.setSubStepsCount(settings.subStepsCount);
+		physicsEngine.setNeighborLists(settings.useNeighborLists, settings.neighborListSkin);
+		physicsEngine.setReorderInterval(settings.reorderInterval);
+		physicsEngine.doIteration();
+	}
+
+	const Vec2Array& getPositions() const noexcept
+	{
+		return positions;
+	}
+
+	const Vec2Array& getVelocities() const noexcept
+	{
+		return velocities;
+	}
+
+	std::uint32_t getParticlesCount() const noexcept
+	{
+		return static_cast<std::uint32_t>(positions.size());
+	}
+
+	/*
+	Hashes of particles are combined by addition, so the checksum doesn't depend on the order in which
+	particles are stored (reordering) as long as every stable id keeps the same state.
+	*/
+	StateSummary getStateSummary() const noexcept
+	{
+		const std::vector<std::uint32_t>& particleIds = physicsEngine.getParticleIds();
+		StateSummary summary{ 0, 0.0, glm::dvec2(0.0) };
+		for (std::uint32_t i = 0; i < positions.size(); ++i)
+		{
+			const glm::vec2 position = positions[i];
+			const glm::vec2 velocity = velocities[i];
+
+			std::uint64_t hash = mixBits(particleIds[i]);
+			hash = mixBits(hash ^ (std::bit_cast<std::uint32_t>(position.x) | static_cast<std::uint64_t>(std::bit_cast<std::uint32_t>(position.y)) << 32));
+			hash = mixBits(hash ^ (std::bit_cast<std::uint32_t>(velocity.x) | static_cast<std::uint64_t>(std::bit_cast<std::uint32_t>(velocity.y)) << 32));
+			summary.checksum += hash;
+
+			summary.kineticEnergy += 0.5 * glm::dot(glm::dvec2(velocity), glm::dvec2(velocity));
+			summary.momentum += glm::dvec2(velocity);
+		}
+		return summary;
+	}
+
+	const std::vector<std::uint32_t>& getParticleIds() const noexcept
+	{
+		return physicsEngine.getParticleIds();
+	}
+
+	std::uint64_t getIterationsCount() const noexcept
+	{
+		return iterationsCount;
+	}
+
+	/*
+	Seed of the start state, taken from the checkpoint after a restore.
+	*/
+	std::uint32_t getSeed() const noexcept
+	{
+		return seed;
+	}
+
+	/*
+	Arrays still mapped from a restored checkpoint are copied first: Windows doesn't replace a file with mapped views,
+	which would make saving over the restored checkpoint fail.
+	*/
+	bool saveCheckpoint(const std::string& path)
+	{
+		const auto detachBuffer = [](auto& buffer)
+		{
+			buffer.detachFromFile();
+		};
+		positions.forEachBuffer(detachBuffer);
+		velocities.forEachBuffer(detachBuffer);
+
+		CheckpointHeader header{};
+		header.layoutId = Layout::LAYOUT_ID;
+		header.xMax = world.xMax;
+		header.yMax = world.yMax;
+		header.radius = world.radius;
+		header.particlesCount = getParticlesCount();
+		header.seed = seed;
+		header.iterationsCount = iterationsCount;
+
+		CheckpointWriter writer(path, header);
+		if (!writer.isOpen())
+		{
+			std::cout << "Can't create checkpoint " << path << "\n";
+			return false;
+		}
+		const auto writeBuffer = [&writer](const auto& buffer)
+		{
+			writer.writeSection(buffer.data(), buffer.size() * sizeof(*buffer.data()));
+		};
+		positions.forEachBuffer(writeBuffer);
+		velocities.forEachBuffer(writeBuffer);
+		const std::vector<std::uint32_t>& particleIds = physicsEngine.getParticleIds();
+		writer.writeSection(particleIds.data(), particleIds.size() * sizeof(std::uint32_t));
+		if (!writer.finish())
+		{
+			return false;
+		}
+		std::cout << "Checkpoint of iteration " << iterationsCount << " saved to " << path << "\n";
+		return true;
+	}
+
+	/*
+	Positions and velocities are mapped from the file and used in place, pages are read on first access.
+	The checkpoint has to match the world size, radius, particles count and layout of this simulation.
+	All sections are loaded into new arrays first, so the running state is replaced only when every one of them loaded.
+	*/
+	bool loadCheckpoint(const std::string& path)
+	{
+		const std::optional<CheckpointHeader> header = readCheckpointHeader(path);
+		if (!header)
+		{
+			return false;
+		}
+		if (header->layoutId != Layout::LAYOUT_ID || header->xMax != world.xMax || header->yMax != world.yMax || header->radius != world.radius
+			|| header->particlesCount != getParticlesCount())
+		{
+			std::cout << "Checkpoint " << path << " doesn't match the world, start with --restore to load it\n";
+			return false;
+		}
+
+		typename Layout::Vec2Array loadedPositions(0);
+		typename Layout::Vec2Array loadedVelocities(0);
+		std::uint32_t section = 0;
+		bool loaded = true;
+		const auto loadBuffer = [&](auto& buffer)
+		{
+			loaded = loaded && loadCheckpointSection(path, *header, section++, getParticlesCount(), buffer);
+		};
+		loadedPositions.forEachBuffer(loadBuffer);
+		loadedVelocities.forEachBuffer(loadBuffer);
+
+		std::vector<std::uint32_t> particleIds(getParticlesCount());
+		loaded = loaded && section < header->sectionsCount && header->sectionSizes[section] == particleIds.size() * sizeof(std::uint32_t)
+			&& readCheckpointSection(path, header->sectionOffsets[section], particleIds.data(), header->sectionSizes[section]);
+		if (!loaded)
+		{
+			std::cout << "Can't load sections of checkpoint " << path << ", particle state is left unchanged\n";
+			return false;
+		}
+
+		positions = std::move(loadedPositions);
+		velocities = std::move(loadedVelocities);
+		physicsEngine.initialize();
+		physicsEngine.setParticleIds(std::move(particleIds));
+		physicsEngine.setIterationsCount(header->iterationsCount);
+		if (activeEngineType == PhysicsEngineType::EventDriven)
+		{
+			eventDrivenEngine.initialize();
+		}
+		seed = header->seed;
+		iterationsCount = header->iterationsCount;
+		std::cout << "Restored " << getParticlesCount() << " particles at iteration " << iterationsCount << " from " << path << "\n";
+		return true;
+	}
+
+	/*
+	Stats of the engine that ran the last iteration.
+	*/
+	const SimulationStats& getSimulationStats() const noexcept
+	{
+		if (activeEngineType == PhysicsEngineType::EventDriven)
+		{
+			return eventDrivenEngine.getSimulationStats();
+		}
+		return physicsEngine.getSimulationStats();
+	}
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,81 @@
+#ifndef SIMULATIONSETTINGS_HPP
+#define SIMULATIONSETTINGS_HPP
+
+#include "Constants.hpp"
+#include "PhaseTimings.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+
+enum class PhysicsEngineType : std::uint8_t
+{
+	TimeStepping,
+	EventDriven
+};
+
+/*
+Physics phases timed by the given engine, the others stay 0 while it is active.
+*/
+constexpr bool isEnginePhase(const PhysicsEngineType engineType, const Phase phase) noexcept
+{
+	const bool eventPhase = phase == Phase::Events || phase == Phase::EventSync;
+	return static_cast<std::uint32_t>(phase) < PHYSICS_PHASES_COUNT && eventPhase == (engineType == PhysicsEngineType::EventDriven);
+}
+
+enum class VelocityDistribution : std::uint8_t
+{
+	Uniform,
+	MaxwellBoltzmann
+};
+
+/*
+Runtime options edited in the control panel and applied by World before every iteration.
+*/
+struct SimulationSettings
+{
+	PhysicsEngineType engineType = PhysicsEngineType::TimeStepping;
+	std::uint32_t threadsCount = std::max(1u, std::thread::hardware_concurrency());
+	std::uint32_t subStepsCount = 5;
+	bool useNeighborLists = false;
+	float neighborListSkin = DEFAULT_CIRCLE_RADIUS;
+	std::uint32_t reorderInterval = 0;
+};
+
+enum class ParticleColoring : std::uint8_t
+{
+	Uniform,
+	Speed
+};
+
+/*
+Options of the windowed renderer edited in the control panel, speeds are mapped linearly onto the colormap.
+Particles are replaced by a density field when there are more than densityFieldRatio of them per pixel of the window.
+*/
+struct RenderSettings
+{
+	ParticleColoring coloring = ParticleColoring::Uniform;
+	float minSpeed = 0.f;
+	float maxSpeed = vxMax;
+	float densityFieldRatio = 1.f;
+};
+
+/*
+Counters reported by the physics engines for display in the control panel.
+*/
+struct SimulationStats
+{
+	std::uint64_t neighborListRebuilds = 0;
+	std::uint64_t neighborListSubSteps = 0;
+	std::uint64_t reordersCount = 0;
+	float indexGapBeforeReorder = 0.f;
+	float indexGapAfterReorder = 0.f;
+	std::uint64_t collisionsCount = 0;
+
+	/*
+	Time spent in physics phases of the last iteration, summed over substeps.
+	*/
+	PhaseDurations phaseDurations;
+};
+
+#endif
\ No newline at end of file
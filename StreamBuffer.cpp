@@ -0,0 +1,102 @@
+#include "StreamBuffer.hpp"
+
+#include <iostream>
+
+namespace
+{
+	constexpr GLuint64 FENCE_WAIT_NS = 1'000'000;
+}
+
+void waitForFence(GLsync& fence) noexcept
+{
+	GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_WAIT_NS);
+	while (result == GL_TIMEOUT_EXPIRED)
+	{
+		result = glClientWaitSync(fence, 0, FENCE_WAIT_NS);
+	}
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
+bool StreamBuffer::initialize(const GLsizeiptr segmentSize_) noexcept
+{
+	segmentSize = segmentSize_;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+	persistent = GLEW_ARB_buffer_storage;
+	if (persistent)
+	{
+		constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, SEGMENTS_COUNT * segmentSize, nullptr, flags);
+		mappedData = static_cast<std::uint8_t*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, SEGMENTS_COUNT * segmentSize, flags));
+		if (mappedData == nullptr)
+		{
+			std::cout << "Persistent mapping of the vertex buffer failed\n";
+			return false;
+		}
+		std::cout << "Streaming vertex buffers: persistent mapping with " << SEGMENTS_COUNT << " segments\n";
+	}
+	else
+	{
+		glBufferData(GL_ARRAY_BUFFER, segmentSize, nullptr, GL_STREAM_DRAW);
+		std::cout << "Streaming vertex buffers: buffer orphaning\n";
+	}
+	return true;
+}
+
+void StreamBuffer::cleanup() noexcept
+{
+	for (GLsync& fence : fences)
+	{
+		if (fence != nullptr)
+		{
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+	}
+	if (mappedData != nullptr)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		mappedData = nullptr;
+	}
+	glDeleteBuffers(1, &buffer);
+}
+
+void* StreamBuffer::beginWrite() noexcept
+{
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	if (!persistent)
+	{
+		glBufferData(GL_ARRAY_BUFFER, segmentSize, nullptr, GL_STREAM_DRAW);
+		return glMapBufferRange(GL_ARRAY_BUFFER, 0, segmentSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	}
+
+	GLsync& fence = fences[segment];
+	if (fence != nullptr)
+	{
+		waitForFence(fence);
+	}
+	return mappedData + segment * segmentSize;
+}
+
+GLintptr StreamBuffer::endWrite() noexcept
+{
+	if (!persistent)
+	{
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		return 0;
+	}
+	return segment * segmentSize;
+}
+
+void StreamBuffer::fenceSegment() noexcept
+{
+	if (!persistent)
+	{
+		return;
+	}
+	fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	segment = (segment + 1) % SEGMENTS_COUNT;
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#ifndef STREAMBUFFER_HPP
+#define STREAMBUFFER_HPP
+
+#include <GL/glew.h>
+
+#include <array>
+#include <cstdint>
+
+/*
+Blocks until the GPU signals the fence, flushing commands once so that it is signaled at all, then deletes it.
+*/
+void waitForFence(GLsync& fence) noexcept;
+
+/*
+Vertex buffer rewritten every frame. With ARB_buffer_storage it is mapped once, persistently and coherently,
+and split into SEGMENTS_COUNT segments written round robin; a fence placed after the draw reading a segment
+keeps the CPU from overwriting it before the GPU is done. Without the extension the buffer storage is
+orphaned and mapped again for every write, so the driver doesn't have to wait for the previous draw either.
+*/
+class StreamBuffer
+{
+private:
+	static constexpr std::uint32_t SEGMENTS_COUNT = 3;
+
+	GLuint buffer = 0;
+	GLsizeiptr segmentSize = 0;
+	bool persistent = false;
+	std::uint8_t* mappedData = nullptr;
+	std::array<GLsync, SEGMENTS_COUNT> fences{};
+	std::uint32_t segment = 0;
+
+public:
+	/*
+	Creates the buffer and binds it to GL_ARRAY_BUFFER.
+	*/
+	bool initialize(const GLsizeiptr segmentSize_) noexcept;
+	void cleanup() noexcept;
+
+	bool isPersistent() const noexcept
+	{
+		return persistent;
+	}
+
+	/*
+	Binds the buffer and returns memory for segmentSize bytes of the next segment, waiting for the GPU
+	if it still reads that segment. Returns nullptr when mapping failed.
+	*/
+	void* beginWrite() noexcept;
+
+	/*
+	Finishes the write, returns the offset of the written segment in the buffer.
+	*/
+	GLintptr endWrite() noexcept;
+
+	/*
+	Called after the draw commands reading the written segment.
+	*/
+	void fenceSegment() noexcept;
+};
+
+#endif
\ No newline at end of file
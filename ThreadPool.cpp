@@ -0,0 +1,88 @@
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(const std::uint32_t threadsCount)
+{
+	workers.reserve(threadsCount > 1 ? threadsCount - 1 : 0);
+	for (std::uint32_t i = 1; i < threadsCount; ++i)
+	{
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = true;
+	}
+	workAvailable.notify_all();
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void ThreadPool::runTasks() noexcept
+{
+	for (std::uint32_t i = nextTaskId.fetch_add(1, std::memory_order_relaxed); i < tasksCount; i = nextTaskId.fetch_add(1, std::memory_order_relaxed))
+	{
+		(*task)(i);
+	}
+}
+
+void ThreadPool::workerLoop() noexcept
+{
+	std::uint64_t lastGeneration = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			workAvailable.wait(lock, [&] {return stop || generation != lastGeneration;});
+			if (stop)
+			{
+				return;
+			}
+			lastGeneration = generation;
+		}
+
+		runTasks();
+
+		bool lastWorker = false;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			lastWorker = --pendingWorkers == 0;
+		}
+		if (lastWorker)
+		{
+			workFinished.notify_one();
+		}
+	}
+}
+
+void ThreadPool::parallelFor(const std::uint32_t tasksCount_, const std::function<void(std::uint32_t)>& task_) noexcept
+{
+	if (workers.empty() || tasksCount_ < 2)
+	{
+		for (std::uint32_t i = 0; i < tasksCount_; ++i)
+		{
+			task_(i);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		task = &task_;
+		tasksCount = tasksCount_;
+		nextTaskId.store(0, std::memory_order_relaxed);
+		pendingWorkers = static_cast<std::uint32_t>(workers.size());
+		++generation;
+	}
+	workAvailable.notify_all();
+
+	runTasks();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	workFinished.wait(lock, [&] {return pendingWorkers == 0;});
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+Persistent pool of worker threads. parallelFor hands out task ids from a shared counter,
+calling thread takes part in the work and returns once every worker has finished the current batch.
+*/
+class ThreadPool
+{
+private:
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable workAvailable;
+	std::condition_variable workFinished;
+
+	const std::function<void(std::uint32_t)>* task = nullptr;
+	std::atomic<std::uint32_t> nextTaskId = 0;
+	std::uint32_t tasksCount = 0;
+	std::uint32_t pendingWorkers = 0;
+	std::uint64_t generation = 0;
+	bool stop = false;
+
+	void workerLoop() noexcept;
+	void runTasks() noexcept;
+
+public:
+	explicit ThreadPool(const std::uint32_t threadsCount);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	std::uint32_t getThreadsCount() const noexcept
+	{
+		return static_cast<std::uint32_t>(workers.size()) + 1;
+	}
+
+	void parallelFor(const std::uint32_t tasksCount_, const std::function<void(std::uint32_t)>& task_) noexcept;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,254 @@
+#include "Trajectory.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+	std::uint32_t zigzagEncode(const std::int32_t value) noexcept
+	{
+		return (static_cast<std::uint32_t>(value) << 1) ^ static_cast<std::uint32_t>(value >> 31);
+	}
+
+	std::int32_t zigzagDecode(const std::uint32_t value) noexcept
+	{
+		return static_cast<std::int32_t>(value >> 1) ^ -static_cast<std::int32_t>(value & 1);
+	}
+
+	std::uint32_t quantize(const float value, const double scale, const std::uint32_t maxValue) noexcept
+	{
+		const double quantized = std::round(value * scale);
+		return static_cast<std::uint32_t>(std::clamp(quantized, 0.0, static_cast<double>(maxValue)));
+	}
+
+	void packValues(const std::vector<std::uint32_t>& values, std::vector<std::uint8_t>& payload)
+	{
+		for (std::size_t begin = 0; begin < values.size(); begin += TRAJECTORY_BLOCK_SIZE)
+		{
+			const std::size_t end = std::min(values.size(), begin + TRAJECTORY_BLOCK_SIZE);
+			std::uint32_t allBits = 0;
+			for (std::size_t i = begin; i < end; ++i)
+			{
+				allBits |= values[i];
+			}
+			const std::uint32_t width = static_cast<std::uint32_t>(std::bit_width(allBits));
+			payload.push_back(static_cast<std::uint8_t>(width));
+
+			std::uint64_t bitBuffer = 0;
+			std::uint32_t bitsCount = 0;
+			for (std::size_t i = begin; i < end; ++i)
+			{
+				bitBuffer |= static_cast<std::uint64_t>(values[i]) << bitsCount;
+				bitsCount += width;
+				while (bitsCount >= 8)
+				{
+					payload.push_back(static_cast<std::uint8_t>(bitBuffer));
+					bitBuffer >>= 8;
+					bitsCount -= 8;
+				}
+			}
+			if (bitsCount > 0)
+			{
+				payload.push_back(static_cast<std::uint8_t>(bitBuffer));
+			}
+		}
+	}
+
+	bool unpackValues(const std::uint8_t*& data, const std::uint8_t* dataEnd, std::vector<std::uint32_t>& values) noexcept
+	{
+		for (std::size_t begin = 0; begin < values.size(); begin += TRAJECTORY_BLOCK_SIZE)
+		{
+			const std::size_t end = std::min(values.size(), begin + TRAJECTORY_BLOCK_SIZE);
+			if (data == dataEnd || *data > 32)
+			{
+				return false;
+			}
+			const std::uint32_t width = *data++;
+			if (static_cast<std::size_t>(dataEnd - data) < (width * (end - begin) + 7) / 8)
+			{
+				return false;
+			}
+
+			const std::uint64_t mask = (std::uint64_t(1) << width) - 1;
+			std::uint64_t bitBuffer = 0;
+			std::uint32_t bitsCount = 0;
+			for (std::size_t i = begin; i < end; ++i)
+			{
+				while (bitsCount < width)
+				{
+					bitBuffer |= static_cast<std::uint64_t>(*data++) << bitsCount;
+					bitsCount += 8;
+				}
+				values[i] = static_cast<std::uint32_t>(bitBuffer & mask);
+				bitBuffer >>= width;
+				bitsCount -= width;
+			}
+		}
+		return true;
+	}
+}
+
+TrajectoryWriter::TrajectoryWriter(const std::string& path, const std::uint32_t particlesCount, const std::uint32_t xMax, const std::uint32_t yMax,
+	const std::uint32_t bits) :
+	file(path, std::ios::binary | std::ios::trunc), header{ TRAJECTORY_MAGIC, TRAJECTORY_VERSION, particlesCount, xMax, yMax, bits, TRAJECTORY_FRAMES_PER_CHUNK },
+	previousX(particlesCount), previousY(particlesCount), values(particlesCount)
+{
+	if (!file)
+	{
+		std::cout << "Can't create trajectory file " << path << "\n";
+		return;
+	}
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	writer.start([this](const Frame& frame) { return writeFrame(frame); });
+}
+
+TrajectoryWriter::~TrajectoryWriter()
+{
+	close();
+}
+
+bool TrajectoryWriter::isOpen() const noexcept
+{
+	return writer.isRunning();
+}
+
+bool TrajectoryWriter::close()
+{
+	if (!writer.isRunning())
+	{
+		return false;
+	}
+	writer.stop();
+
+	const TrajectoryFooter footer{ static_cast<std::uint64_t>(file.tellp()), chunks.size(), TRAJECTORY_MAGIC };
+	file.write(reinterpret_cast<const char*>(chunks.data()), static_cast<std::streamsize>(chunks.size() * sizeof(TrajectoryChunk)));
+	file.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+	file.close();
+	if (!file)
+	{
+		std::cout << "Writing trajectory failed\n";
+		return false;
+	}
+	return true;
+}
+
+bool TrajectoryWriter::writeFrame(const Frame& frame)
+{
+	if (chunks.empty() || chunks.back().framesCount == header.framesPerChunk)
+	{
+		chunks.push_back({ static_cast<std::uint64_t>(file.tellp()), frame.iteration, 0 });
+		std::fill(previousX.begin(), previousX.end(), 0);
+		std::fill(previousY.begin(), previousY.end(), 0);
+	}
+	++chunks.back().framesCount;
+
+	const std::uint32_t maxValue = static_cast<std::uint32_t>((std::uint64_t(1) << header.bits) - 1);
+	const double xScale = maxValue / static_cast<double>(header.xMax);
+	const double yScale = maxValue / static_cast<double>(header.yMax);
+
+	payload.clear();
+	for (std::uint32_t i = 0; i < frame.positions.size(); ++i)
+	{
+		const std::uint32_t x = quantize(frame.positions[i].x, xScale, maxValue);
+		values[i] = zigzagEncode(static_cast<std::int32_t>(x - previousX[i]));
+		previousX[i] = x;
+	}
+	packValues(values, payload);
+	for (std::uint32_t i = 0; i < frame.positions.size(); ++i)
+	{
+		const std::uint32_t y = quantize(frame.positions[i].y, yScale, maxValue);
+		values[i] = zigzagEncode(static_cast<std::int32_t>(y - previousY[i]));
+		previousY[i] = y;
+	}
+	packValues(values, payload);
+
+	const std::uint32_t payloadSize = static_cast<std::uint32_t>(payload.size());
+	file.write(reinterpret_cast<const char*>(&frame.iteration), sizeof(frame.iteration));
+	file.write(reinterpret_cast<const char*>(&payloadSize), sizeof(payloadSize));
+	file.write(reinterpret_cast<const char*>(payload.data()), payloadSize);
+	return static_cast<bool>(file);
+}
+
+bool TrajectoryReader::open(const std::string& path)
+{
+	file.open(path, std::ios::binary);
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != TRAJECTORY_MAGIC || header.version != TRAJECTORY_VERSION)
+	{
+		std::cout << path << " isn't a trajectory file of version " << TRAJECTORY_VERSION << "\n";
+		return false;
+	}
+
+	TrajectoryFooter footer;
+	file.seekg(-static_cast<std::streamoff>(sizeof(footer)), std::ios::end);
+	if (!file.read(reinterpret_cast<char*>(&footer), sizeof(footer)) || footer.magic != TRAJECTORY_MAGIC)
+	{
+		std::cout << "Trajectory " << path << " wasn't closed properly\n";
+		return false;
+	}
+	chunks.resize(footer.chunksCount);
+	file.seekg(static_cast<std::streamoff>(footer.indexOffset));
+	if (!file.read(reinterpret_cast<char*>(chunks.data()), static_cast<std::streamsize>(chunks.size() * sizeof(TrajectoryChunk))))
+	{
+		std::cout << "Can't read index of trajectory " << path << "\n";
+		return false;
+	}
+
+	framesCount = 0;
+	for (const TrajectoryChunk& chunk : chunks)
+	{
+		framesCount += chunk.framesCount;
+	}
+	currentX.resize(header.particlesCount);
+	currentY.resize(header.particlesCount);
+	return true;
+}
+
+bool TrajectoryReader::readFrame(const std::uint64_t frameIndex, std::uint64_t& iteration, std::vector<glm::vec2>& positions)
+{
+	const std::uint64_t chunkIndex = frameIndex / header.framesPerChunk;
+	if (frameIndex >= framesCount || chunkIndex >= chunks.size())
+	{
+		return false;
+	}
+
+	file.clear();
+	file.seekg(static_cast<std::streamoff>(chunks[chunkIndex].offset));
+	std::fill(currentX.begin(), currentX.end(), 0);
+	std::fill(currentY.begin(), currentY.end(), 0);
+	std::vector<std::uint32_t> values(header.particlesCount);
+	for (std::uint64_t frame = chunkIndex * header.framesPerChunk; frame <= frameIndex; ++frame)
+	{
+		std::uint32_t payloadSize = 0;
+		file.read(reinterpret_cast<char*>(&iteration), sizeof(iteration));
+		file.read(reinterpret_cast<char*>(&payloadSize), sizeof(payloadSize));
+		payload.resize(payloadSize);
+		if (!file.read(reinterpret_cast<char*>(payload.data()), payloadSize))
+		{
+			return false;
+		}
+
+		const std::uint8_t* data = payload.data();
+		const std::uint8_t* dataEnd = data + payload.size();
+		for (std::vector<std::uint32_t>* current : { &currentX, &currentY })
+		{
+			if (!unpackValues(data, dataEnd, values))
+			{
+				return false;
+			}
+			for (std::uint32_t i = 0; i < header.particlesCount; ++i)
+			{
+				(*current)[i] += static_cast<std::uint32_t>(zigzagDecode(values[i]));
+			}
+		}
+	}
+
+	const double maxValue = static_cast<double>((std::uint64_t(1) << header.bits) - 1);
+	positions.resize(header.particlesCount);
+	for (std::uint32_t i = 0; i < header.particlesCount; ++i)
+	{
+		positions[i] = glm::vec2(currentX[i] * (header.xMax / maxValue), currentY[i] * (header.yMax / maxValue));
+	}
+	return true;
+}
\ No newline at end of file
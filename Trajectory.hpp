@@ -0,0 +1,151 @@
+#ifndef TRAJECTORY_HPP
+#define TRAJECTORY_HPP
+
+#include <glm/vec2.hpp>
+
+#include "BackgroundWriter.hpp"
+
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+constexpr std::uint32_t TRAJECTORY_VERSION = 1;
+constexpr std::array<char, 8> TRAJECTORY_MAGIC = { '2', 'd', 'E', 'C', 'T', 'R', 'A', 'J' };
+
+/*
+Trajectory file: header, frames grouped in chunks, index of chunks and footer pointing to the index.
+Positions are quantized to fixed point with the given bits relative to the world size and stored in stable id order.
+The first frame of a chunk is encoded against zero, so every chunk can be decoded on its own, the rest against the previous frame.
+Frame payload holds zigzag encoded deltas of x components followed by y components, packed in blocks of
+TRAJECTORY_BLOCK_SIZE values with the bit width of the largest value in the block stored in front of it.
+*/
+struct TrajectoryHeader
+{
+	std::array<char, 8> magic;
+	std::uint32_t version;
+	std::uint32_t particlesCount;
+	std::uint32_t xMax;
+	std::uint32_t yMax;
+	std::uint32_t bits;
+	std::uint32_t framesPerChunk;
+};
+
+struct TrajectoryChunk
+{
+	std::uint64_t offset;
+	std::uint64_t firstIteration;
+	std::uint64_t framesCount;
+};
+
+struct TrajectoryFooter
+{
+	std::uint64_t indexOffset;
+	std::uint64_t chunksCount;
+	std::array<char, 8> magic;
+};
+
+constexpr std::uint32_t TRAJECTORY_BLOCK_SIZE = 128;
+constexpr std::uint32_t TRAJECTORY_FRAMES_PER_CHUNK = 64;
+
+/*
+Frames are copied in stable id order on the simulation thread and encoded and written by a background thread.
+At most MAX_QUEUED_FRAMES wait for encoding, adding more blocks until one is written.
+*/
+class TrajectoryWriter
+{
+private:
+	static constexpr std::uint32_t MAX_QUEUED_FRAMES = 4;
+
+	struct Frame
+	{
+		std::uint64_t iteration = 0;
+		std::vector<glm::vec2> positions;
+	};
+
+	std::ofstream file;
+	TrajectoryHeader header;
+	std::vector<TrajectoryChunk> chunks;
+
+	std::vector<std::uint32_t> previousX;
+	std::vector<std::uint32_t> previousY;
+	std::vector<std::uint32_t> values;
+	std::vector<std::uint8_t> payload;
+
+	BackgroundWriter<Frame> writer{ MAX_QUEUED_FRAMES };
+
+	bool writeFrame(const Frame& frame);
+
+public:
+	TrajectoryWriter(const std::string& path, const std::uint32_t particlesCount, const std::uint32_t xMax, const std::uint32_t yMax, const std::uint32_t bits);
+	~TrajectoryWriter();
+
+	TrajectoryWriter(const TrajectoryWriter&) = delete;
+	TrajectoryWriter& operator=(const TrajectoryWriter&) = delete;
+
+	bool isOpen() const noexcept;
+
+	/*
+	Writes queued frames, the index and the footer. Called by the destructor when not called before.
+	*/
+	bool close();
+
+	template<typename PosArrType>
+	void addFrame(const std::uint64_t iteration, const PosArrType& positions, const std::vector<std::uint32_t>& particleIds)
+	{
+		std::unique_ptr<Frame> frame = writer.takeFreeItem();
+		frame->iteration = iteration;
+		frame->positions.resize(positions.size());
+		for (std::uint32_t i = 0; i < positions.size(); ++i)
+		{
+			frame->positions[particleIds[i]] = positions[i];
+		}
+		writer.queueItem(std::move(frame));
+	}
+};
+
+/*
+Random access to frames of a trajectory file, decoding starts at the chunk holding the requested frame.
+*/
+class TrajectoryReader
+{
+private:
+	std::ifstream file;
+	TrajectoryHeader header{};
+	std::vector<TrajectoryChunk> chunks;
+	std::uint64_t framesCount = 0;
+	std::vector<std::uint32_t> currentX;
+	std::vector<std::uint32_t> currentY;
+	std::vector<std::uint8_t> payload;
+
+public:
+	bool open(const std::string& path);
+
+	const TrajectoryHeader& getHeader() const noexcept
+	{
+		return header;
+	}
+
+	std::uint64_t getFramesCount() const noexcept
+	{
+		return framesCount;
+	}
+
+	/*
+	Half of the quantization step in world units, decoded positions of particles inside the world are at most this far from the written ones.
+	*/
+	glm::vec2 getQuantizationErrorBound() const noexcept
+	{
+		const double maxValue = static_cast<double>((std::uint64_t(1) << header.bits) - 1);
+		return glm::vec2(0.5 * header.xMax / maxValue, 0.5 * header.yMax / maxValue);
+	}
+
+	/*
+	Positions are returned in stable id order.
+	*/
+	bool readFrame(const std::uint64_t frameIndex, std::uint64_t& iteration, std::vector<glm::vec2>& positions);
+};
+
+#endif
\ No newline at end of file
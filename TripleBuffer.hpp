@@ -0,0 +1,70 @@
+#ifndef TRIPLEBUFFER_HPP
+#define TRIPLEBUFFER_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/*
+Lock-free handoff of the latest value from one producer thread to one consumer thread.
+The producer fills the back slot and publishes it by swapping it with the shared middle slot,
+the consumer swaps its front slot with the middle one when a newer value was published.
+Neither side ever waits, values published faster than they are consumed are skipped.
+*/
+template<typename T>
+class TripleBuffer
+{
+private:
+	static constexpr std::uint8_t INDEX_MASK = 0b011;
+	static constexpr std::uint8_t NEW_VALUE_BIT = 0b100;
+
+	std::array<T, 3> slots;
+	std::atomic<std::uint8_t> middle{ 1 };
+	std::uint8_t back = 0;
+	std::uint8_t front = 2;
+
+public:
+	template<typename... Args>
+	explicit TripleBuffer(const Args&... args) : slots{ T(args...), T(args...), T(args...) }
+	{
+	}
+
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+	/*
+	Slot owned by the producer until publish().
+	*/
+	T& getBack() noexcept
+	{
+		return slots[back];
+	}
+
+	void publish() noexcept
+	{
+		back = middle.exchange(back | NEW_VALUE_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+	}
+
+	/*
+	Takes the most recently published value, returns false when nothing was published since the last call.
+	*/
+	bool update() noexcept
+	{
+		if (!(middle.load(std::memory_order_relaxed) & NEW_VALUE_BIT))
+		{
+			return false;
+		}
+		front = middle.exchange(front, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+
+	/*
+	Slot owned by the consumer until the next update().
+	*/
+	const T& getFront() const noexcept
+	{
+		return slots[front];
+	}
+};
+
+#endif
\ No newline at end of file
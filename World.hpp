@@ -1,45 +1,299 @@
 #ifndef WORLD_HPP
 #define WORLD_HPP
 
-#include "Physics.hpp"
+#include "Simulation.hpp"
 #include "Renderer2d.hpp"
+#include "Config.hpp"
+#include "DensityField.hpp"
+#include "Profiler.hpp"
+#include "Trajectory.hpp"
+#include "TripleBuffer.hpp"
 
-#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
-template<std::uint32_t xMax, std::uint32_t yMax>
+/*
+Particle state published by the physics thread for rendering.
+*/
+template<typename Layout>
+struct SimulationSnapshot
+{
+	typename Layout::Vec2Array positions;
+	typename Layout::Vec2Array velocities;
+	SimulationStats stats;
+	std::uint64_t iteration = 0;
+
+	/*
+	Empty unless the renderer draws the density field.
+	*/
+	std::vector<glm::vec2> densityField;
+
+	explicit SimulationSnapshot(const std::uint32_t particlesCount) : positions(particlesCount), velocities(particlesCount)
+	{
+	}
+};
+
+/*
+Physics runs unthrottled on its own thread and publishes every finished iteration through a triple buffer,
+the main thread renders the latest published state and passes control panel input back under a mutex.
+Offscreen capture runs in lockstep instead: only every capture interval-th iteration is published, and physics
+waits until the renderer has drawn the previous one, so every captured frame shows its exact iteration.
+*/
+template<typename Layout = AosLayout>
 class World
 {
 private:
-	std::array<glm::vec2, getBallCount(xMax, yMax)> posArr;
-	std::array<glm::vec2, getBallCount(xMax, yMax)> velArr;
-	Physics<decltype(posArr), decltype(velArr)> physicsEngine;
-	Renderer2d<decltype(posArr), decltype(velArr)> renderer;
+	using RendererType = Renderer2d<typename Layout::Vec2Array, typename Layout::Vec2Array>;
+
+	Simulation<Layout> simulation;
+	DensityField densityField;
+	RendererType renderer;
+	const Config config;
+	std::unique_ptr<TrajectoryWriter> trajectoryWriter;
+	TripleBuffer<SimulationSnapshot<Layout>> snapshots;
+	std::thread physicsThread;
+
+	/*
+	Control panel state copied by the main thread after every frame, taken by the physics thread before every iteration.
+	*/
+	std::mutex controlMutex;
+	std::condition_variable controlChanged;
+	SimulationSettings settings;
+	bool pause = false;
+	bool buildDensityField = false;
+	bool stop = false;
+	CheckpointRequest checkpointRequest = CheckpointRequest::None;
+	std::string checkpointPath;
+	std::uint64_t publishedIteration = 0;
+	std::uint64_t renderedIteration = std::numeric_limits<std::uint64_t>::max();
+
+	void writeTrajectoryFrame()
+	{
+		if (trajectoryWriter && simulation.getIterationsCount() % config.trajectoryInterval == 0)
+		{
+			trajectoryWriter->addFrame(simulation.getIterationsCount(), simulation.getPositions(), simulation.getParticleIds());
+		}
+	}
+
+	/*
+	Particle arrays are copied even when the density field is drawn, they feed the velocity histograms.
+	*/
+	void publishSnapshot(const bool withDensityField) noexcept
+	{
+		SimulationSnapshot<Layout>& snapshot = snapshots.getBack();
+		copyVectors(simulation.getPositions(), snapshot.positions);
+		copyVectors(simulation.getVelocities(), snapshot.velocities);
+		snapshot.stats = simulation.getSimulationStats();
+		snapshot.iteration = simulation.getIterationsCount();
+		if (withDensityField)
+		{
+			PROFILE_ZONE("Density field");
+			densityField.build(simulation.getPositions(), simulation.getVelocities(), snapshot.densityField);
+		}
+		else
+		{
+			snapshot.densityField.clear();
+		}
+		snapshots.publish();
+	}
+
+	/*
+	Offscreen capture only, returns false when stopped while waiting.
+	*/
+	bool publishCapturedSnapshot(const bool withDensityField)
+	{
+		if (simulation.getIterationsCount() % config.capture.interval != 0)
+		{
+			return true;
+		}
+		{
+			std::unique_lock<std::mutex> lock(controlMutex);
+			controlChanged.wait(lock, [this] { return stop || renderedIteration == publishedIteration; });
+			if (stop)
+			{
+				return false;
+			}
+			publishedIteration = simulation.getIterationsCount();
+		}
+		publishSnapshot(withDensityField);
+		return true;
+	}
+
+	/*
+	A failed load leaves the simulation as it was, only a loaded checkpoint publishes a new snapshot.
+	*/
+	void handleCheckpointRequest(const CheckpointRequest request, const std::string& path, const bool withDensityField)
+	{
+		switch (request)
+		{
+		case CheckpointRequest::Save:
+			simulation.saveCheckpoint(path);
+			break;
+		case CheckpointRequest::Load:
+			if (simulation.loadCheckpoint(path))
+			{
+				publishSnapshot(withDensityField);
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	void physicsLoop()
+	{
+		while (true)
+		{
+			SimulationSettings currentSettings;
+			CheckpointRequest request;
+			std::string path;
+			bool paused;
+			bool withDensityField;
+			{
+				std::unique_lock<std::mutex> lock(controlMutex);
+				controlChanged.wait(lock, [this] { return stop || !pause || checkpointRequest != CheckpointRequest::None; });
+				if (stop)
+				{
+					return;
+				}
+				currentSettings = settings;
+				request = std::exchange(checkpointRequest, CheckpointRequest::None);
+				path = checkpointPath;
+				paused = pause;
+				withDensityField = buildDensityField;
+			}
+
+			handleCheckpointRequest(request, path, withDensityField);
+			if (!paused)
+			{
+				simulation.doIteration(currentSettings);
+				writeTrajectoryFrame();
+				if (!config.capture.offscreen)
+				{
+					publishSnapshot(withDensityField);
+				}
+				else if (!publishCapturedSnapshot(withDensityField))
+				{
+					return;
+				}
+			}
+		}
+	}
+
+	void sendControlState(const std::uint64_t iteration)
+	{
+		{
+			std::lock_guard<std::mutex> lock(controlMutex);
+			renderedIteration = iteration;
+			settings = renderer.getSimulationSettings();
+			pause = renderer.pauseSimulation();
+			buildDensityField = renderer.drawsDensityField();
+			const CheckpointRequest request = renderer.takeCheckpointRequest();
+			if (request != CheckpointRequest::None)
+			{
+				checkpointRequest = request;
+				checkpointPath = renderer.getCheckpointPath();
+			}
+		}
+		controlChanged.notify_one();
+	}
+
+	void stopPhysicsThread()
+	{
+		{
+			std::lock_guard<std::mutex> lock(controlMutex);
+			stop = true;
+		}
+		controlChanged.notify_one();
+		physicsThread.join();
+	}
 
 public:
-	World() noexcept : physicsEngine(posArr, velArr, xMax, yMax), renderer(posArr, velArr, xMax, yMax)
+	World(const Config& config_) : simulation(config_.world),
+		densityField(config_.world.xMax, config_.world.yMax, DENSITY_FIELD_TEXEL_PIXELS / RendererType::getWindowScale(config_.world.xMax, config_.world.yMax)),
+		renderer(config_.world.getParticlesCount(), config_.world.xMax, config_.world.yMax, config_.world.radius, densityField.getWidth(), densityField.getHeight(),
+			config_.settings, config_.renderSettings, config_.capture),
+		config(config_), snapshots(config_.world.getParticlesCount()), settings(config_.settings)
 	{
 	}
 
 	bool initializeWorld()
 	{
-		physicsEngine.generateStartValues();
+		setProfilerEnabled(!config.profilePath.empty());
+		if (!config.restorePath.empty())
+		{
+			if (!simulation.loadCheckpoint(config.restorePath))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			std::cout << "Seed: " << config.seed << "\n";
+			simulation.generateStartValues(config.seed, config.velocityDistribution, config.temperature);
+		}
+		buildDensityField = renderer.drawsDensityField();
+		publishedIteration = simulation.getIterationsCount();
+		publishSnapshot(buildDensityField);
+
+		if (!config.trajectoryPath.empty())
+		{
+			trajectoryWriter = std::make_unique<TrajectoryWriter>(config.trajectoryPath, simulation.getParticlesCount(), config.world.xMax, config.world.yMax,
+				config.trajectoryBits);
+			if (!trajectoryWriter->isOpen())
+			{
+				return false;
+			}
+			writeTrajectoryFrame();
+		}
 		return renderer.initialize();
 	}
 
 	void run()
 	{
+		physicsThread = std::thread(&World::physicsLoop, this);
 		while (renderer.isWindowActive())
 		{
-			if (renderer.pauseSimulation())
+			if (snapshots.update())
+			{
+				renderer.setSimulationStats(snapshots.getFront().stats);
+			}
+			else if (renderer.isOffscreen())
 			{
-				renderer.render();
+				/*
+				Offscreen frames are only captured, so each of them shows a new state.
+				*/
+				std::this_thread::sleep_for(std::chrono::microseconds(200));
 				continue;
 			}
-			physicsEngine.doIteration();
-			renderer.render();
+			const SimulationSnapshot<Layout>& snapshot = snapshots.getFront();
+			renderer.render(snapshot.positions, snapshot.velocities, snapshot.densityField, snapshot.iteration);
+			sendControlState(snapshot.iteration);
 		}
+		stopPhysicsThread();
 
 		renderer.cleanup();
+		if (trajectoryWriter)
+		{
+			trajectoryWriter->close();
+		}
+		if (!config.checkpointPath.empty())
+		{
+			simulation.saveCheckpoint(config.checkpointPath);
+		}
+		if (!config.profilePath.empty())
+		{
+			writeChromeTrace(config.profilePath);
+		}
 	}
 };
 
@@ -1,8 +1,27 @@
 #include "World.hpp"
+#include "Config.hpp"
+#include "NarrowPhase.hpp"
 
-int main()
+#include <iostream>
+
+int main(int argc, char** argv)
 {
-	World<1600, 900> world;
+	const std::optional<Config> config = parseConfig(argc, argv);
+	if (!config)
+	{
+		return 1;
+	}
+
+	/*
+	Captured frames streamed to stdout would be corrupted by messages, they go to stderr instead.
+	*/
+	if (config->capture.path == "-")
+	{
+		std::cout.rdbuf(std::cerr.rdbuf());
+	}
+	std::cout << "Narrow phase kernel: " << getNarrowPhaseKernelName(detectNarrowPhaseKernel()) << "\n";
+
+	World world(config.value());
 
 	if (world.initializeWorld())
 	{